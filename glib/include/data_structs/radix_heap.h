@@ -0,0 +1,103 @@
+#ifndef _RADIX_HEAP_H
+#define _RADIX_HEAP_H
+
+
+/*
+ * Radix heaps are monotone priority queues, as described in the paper at
+ * https://dl.acm.org/doi/10.1145/77600.77615 (Ahuja, Mehlhorn, Orlin, and
+ * Tarjan, "Faster Algorithms for the Shortest Path Problem")
+ *
+ * They can only be used when the key of every inserted node is no less than
+ * the key of the last node extracted, which is the case for the nodes of
+ * Dijkstra's algorithm. Nodes are kept in buckets by the highest bit in which
+ * their key differs from the last extracted key, so inserting and decreasing
+ * a key are constant time, and a node is moved to a lower bucket at most once
+ * per bit of the key before it is extracted
+ *
+ *
+ *
+ * Like the pairing heap in min_heap.h, the nodes of the heap are meant to be
+ * inlined in whatever structure is to be stored in the heap. On extract min,
+ * a pointer to the radix heap node is returned, and it is up to the user to
+ * translate this back to whatever structure contains this node
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef uint64_t radix_key_t;
+
+
+/*
+ * each bucket is a doubly-linked list of the nodes in it, where the first
+ * node of the list has prev set to NULL and the last has next set to NULL
+ */
+typedef struct radix_node {
+    struct radix_node * next;
+    struct radix_node * prev;
+
+    // key associated with node, determines its priority
+    radix_key_t key;
+} radix_node;
+
+
+// initialize radix heap node with key value k
+#define RADIX_NODE_SET(radix_node, k) \
+    ((radix_node)->key = ((radix_key_t) k))
+
+
+// bucket 0 holds the nodes with key equal to the last extracted key, and
+// bucket b > 0 holds those whose highest bit differing from it is bit b - 1
+#define RADIX_N_BUCKETS 65
+
+
+typedef struct radix_heap {
+    // key of the last node extracted, which no node in the heap is less than
+    radix_key_t last;
+
+    // bit b - 1 is set iff bucket b > 0 is not empty
+    uint64_t nonempty;
+
+    radix_node * buckets[RADIX_N_BUCKETS];
+} radix_heap_t;
+
+
+
+int radix_heap_init(radix_heap_t *h);
+
+void radix_heap_destroy(radix_heap_t *h);
+
+
+/*
+ * removes the node with the minimum key value from the heap and returns it,
+ * or returns NULL if the heap is empty
+ */
+radix_node * radix_heap_extract_min(radix_heap_t *h);
+
+
+/*
+ * inserts a node into the heap. The node must already be initialized, i.e.
+ * its key must be set, and its key may not be less than the key of the last
+ * node extracted
+ *
+ * returns 0 on success, nonzero if fails
+ */
+int radix_heap_insert(radix_heap_t *h, radix_node * node);
+
+
+/*
+ * decreases key value of node, which must be in the heap, to the new key
+ * value, which may not be less than the key of the last node extracted
+ */
+int radix_heap_decrease_key(radix_heap_t *h, radix_node * node,
+        radix_key_t new_key);
+
+
+/*
+ * validates the heap, aborting on failure and returning on success
+ */
+void radix_heap_validate(radix_heap_t *h);
+
+
+#endif /* _RADIX_HEAP_H */
@@ -0,0 +1,108 @@
+#ifndef _TRANS_TABLE_H
+#define _TRANS_TABLE_H
+/*
+ * Transposition tables are fixed-size, direct-mapped caches from 64-bit keys
+ * to 64-bit values, which may be read from and written to by any number of
+ * threads at once without locking
+ *
+ *
+ * Each slot stores its value along with the key xor'd with the value, as
+ * described by Hyatt and Mann in "A lock-less transposition table
+ * implementation for parallel search chess engines". The two words are written
+ * separately, so a slot being written by two threads at once may end up with
+ * the value of one and the key of the other, but then the key no longer
+ * matches when it is xor'd back out, and the slot just looks empty
+ *
+ * Whenever two keys map to the same slot, the newer one replaces the older
+ *
+ * Keys should be the output of a good hash function, as the low bits of the
+ * key pick the slot. The key 0 is reserved to mean an empty slot
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+
+// number of sets of hit/miss/eviction counters each table keeps. Each thread
+// that uses the table counts in its own set (once more threads than this have
+// used tables, they start sharing sets, and a few counts may be lost)
+#define TRANS_TABLE_N_COUNTERS 64
+
+
+typedef struct trans_table_entry {
+    _Atomic uint64_t check;
+    _Atomic uint64_t val;
+} trans_table_entry;
+
+
+typedef struct trans_table_stats {
+    // number of lookups which found their key
+    uint64_t hits;
+    // number of lookups which did not
+    uint64_t misses;
+    // number of stores which replaced an entry with a different key
+    uint64_t evictions;
+} trans_table_stats;
+
+
+/*
+ * one thread's counts, padded out to a cache line so that threads counting at
+ * once don't contend
+ */
+typedef struct trans_table_counters {
+    _Atomic uint64_t hits;
+    _Atomic uint64_t misses;
+    _Atomic uint64_t evictions;
+
+    uint64_t __pad[5];
+} trans_table_counters;
+
+
+typedef struct trans_table {
+    // number of slots - 1, where the number of slots is a power of 2
+    uint64_t mask;
+
+    trans_table_entry * entries;
+
+    // TRANS_TABLE_N_COUNTERS sets of counters, aligned to a cache line
+    trans_table_counters * counters;
+} trans_table_t;
+
+
+/*
+ * initializes an empty table with 2^log_n_entries slots
+ *
+ * returns 0 on success, nonzero if fails
+ */
+int trans_table_init(trans_table_t *t, uint32_t log_n_entries);
+
+void trans_table_destroy(trans_table_t *t);
+
+/*
+ * removes every entry from the table, which must not be in use by any other
+ * thread
+ */
+void trans_table_clear(trans_table_t *t);
+
+
+/*
+ * looks up key in the table, writing its value to *val if found
+ *
+ * returns 1 if the key was found, 0 if not
+ */
+int trans_table_lookup(trans_table_t *t, uint64_t key, uint64_t *val);
+
+/*
+ * stores val as the value of key, replacing whatever was in the key's slot
+ */
+void trans_table_store(trans_table_t *t, uint64_t key, uint64_t val);
+
+
+/*
+ * writes the hit/miss/eviction counts of the table since it was initialized
+ * to *stats, summed over every thread that has used it
+ */
+void trans_table_get_stats(trans_table_t *t, trans_table_stats *stats);
+
+
+#endif /* _TRANS_TABLE_H */
@@ -0,0 +1,70 @@
+#ifndef _WS_DEQUE_H
+#define _WS_DEQUE_H
+/*
+ * Work-stealing deques, as described by Chase and Lev in "Dynamic Circular
+ * Work-Stealing Deque", with the C11 memory orderings given by Le et al. in
+ * "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * (https://fzn.fr/readings/ppopp13.pdf)
+ *
+ *
+ * Each deque has a single owner thread, which pushes and pops items at the
+ * bottom of the deque like a stack. Any other thread may concurrently steal
+ * items from the top of the deque, so the oldest items are the ones stolen
+ *
+ * Unlike the paper, the buffer is of fixed capacity, and pushing onto a full
+ * deque fails rather than growing the buffer, so that no memory is ever
+ * reclaimed while another thread could be reading it
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+
+typedef struct ws_deque {
+    // index of the next item to be stolen
+    _Atomic int64_t top;
+    // index one past the last item pushed
+    _Atomic int64_t bottom;
+
+    // capacity - 1, where capacity is a power of 2
+    int64_t mask;
+
+    _Atomic(void *) * buf;
+} ws_deque_t;
+
+
+/*
+ * initializes an empty deque which can hold up to 2^log_cap items
+ *
+ * returns 0 on success, nonzero if fails
+ */
+int ws_deque_init(ws_deque_t *d, uint32_t log_cap);
+
+void ws_deque_destroy(ws_deque_t *d);
+
+
+/*
+ * pushes item onto the bottom of the deque, may only be called by the owner
+ *
+ * returns 0 on success, nonzero if the deque is full
+ */
+int ws_deque_push(ws_deque_t *d, void *item);
+
+/*
+ * pops the item at the bottom of the deque (the most recently pushed), may
+ * only be called by the owner
+ *
+ * returns NULL if the deque is empty
+ */
+void * ws_deque_pop(ws_deque_t *d);
+
+/*
+ * steals the item at the top of the deque (the least recently pushed), may be
+ * called by any thread
+ *
+ * returns NULL if the deque is empty or another thread took the item first
+ */
+void * ws_deque_steal(ws_deque_t *d);
+
+
+#endif /* _WS_DEQUE_H */
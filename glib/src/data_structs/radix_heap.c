@@ -0,0 +1,150 @@
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <data_structs/radix_heap.h>
+
+
+
+#define RADIX_ASSERT(expr) \
+    assert(expr)
+
+
+/*
+ * gives the bucket a node with the given key belongs in, which is determined
+ * by the highest bit in which key differs from the last extracted key
+ */
+static uint32_t _bucket(radix_heap_t *h, radix_key_t key) {
+    radix_key_t diff = key ^ h->last;
+    return (diff == 0) ? 0 : 64 - __builtin_clzll(diff);
+}
+
+
+static void _push(radix_heap_t *h, radix_node * node, uint32_t b) {
+    radix_node * head = h->buckets[b];
+
+    node->prev = NULL;
+    node->next = head;
+    if (head != NULL) {
+        head->prev = node;
+    }
+    h->buckets[b] = node;
+
+    if (b != 0) {
+        h->nonempty |= 1LU << (b - 1);
+    }
+}
+
+
+static void _unlink(radix_heap_t *h, radix_node * node, uint32_t b) {
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    }
+    else {
+        h->buckets[b] = node->next;
+        if (node->next == NULL && b != 0) {
+            h->nonempty &= ~(1LU << (b - 1));
+        }
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    }
+}
+
+
+
+int radix_heap_init(radix_heap_t *h) {
+    h->last = 0;
+    h->nonempty = 0;
+    memset(h->buckets, 0, sizeof(h->buckets));
+    return 0;
+}
+
+
+void radix_heap_destroy(radix_heap_t *h) {
+}
+
+
+
+radix_node * radix_heap_extract_min(radix_heap_t *h) {
+    if (h->buckets[0] == NULL) {
+        if (h->nonempty == 0) {
+            return NULL;
+        }
+
+        // the min is in the lowest nonempty bucket
+        uint32_t b = __builtin_ctzll(h->nonempty) + 1;
+        radix_node * list = h->buckets[b];
+
+        radix_key_t min = list->key;
+        for (radix_node * node = list->next; node != NULL; node = node->next) {
+            if (node->key < min) {
+                min = node->key;
+            }
+        }
+
+        h->buckets[b] = NULL;
+        h->nonempty &= ~(1LU << (b - 1));
+
+        // all nodes of the bucket agree with the new min in every bit above
+        // b - 1 and are no less than it, so they all move to lower buckets,
+        // and the nodes in the buckets above stay where they are
+        h->last = min;
+        while (list != NULL) {
+            radix_node * next = list->next;
+            _push(h, list, _bucket(h, list->key));
+            list = next;
+        }
+    }
+
+    radix_node * min = h->buckets[0];
+    _unlink(h, min, 0);
+    return min;
+}
+
+
+int radix_heap_insert(radix_heap_t *h, radix_node * node) {
+    RADIX_ASSERT(node->key >= h->last);
+
+    _push(h, node, _bucket(h, node->key));
+    return 0;
+}
+
+
+int radix_heap_decrease_key(radix_heap_t *h, radix_node * node,
+        radix_key_t new_key) {
+    RADIX_ASSERT(new_key <= node->key && new_key >= h->last);
+
+    uint32_t old_b = _bucket(h, node->key);
+    uint32_t new_b = _bucket(h, new_key);
+
+    node->key = new_key;
+    if (new_b != old_b) {
+        _unlink(h, node, old_b);
+        _push(h, node, new_b);
+    }
+    return 0;
+}
+
+
+
+void radix_heap_validate(radix_heap_t *h) {
+    for (uint32_t b = 0; b < RADIX_N_BUCKETS; b++) {
+        radix_node * prev = NULL;
+
+        if (b != 0) {
+            RADIX_ASSERT((h->buckets[b] != NULL) ==
+                    ((h->nonempty >> (b - 1)) & 1));
+        }
+
+        for (radix_node * node = h->buckets[b]; node != NULL;
+                node = node->next) {
+            RADIX_ASSERT(node->prev == prev);
+            RADIX_ASSERT(node->key >= h->last);
+            RADIX_ASSERT(_bucket(h, node->key) == b);
+            prev = node;
+        }
+    }
+}
+
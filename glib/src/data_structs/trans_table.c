@@ -0,0 +1,129 @@
+#include <stdlib.h>
+
+#include <data_structs/trans_table.h>
+
+
+#define CACHE_LINE 64
+
+_Static_assert(sizeof(trans_table_counters) == CACHE_LINE,
+        "counters must fill exactly one cache line");
+
+
+// number of threads that have been given a set of counters so far
+static _Atomic uint32_t __n_counter_threads;
+
+// index of the set of counters this thread counts in, plus 1, or 0 if this
+// thread has not used a table yet
+static __thread uint32_t __counter_idx;
+
+
+/*
+ * gives the set of counters of t the calling thread counts in
+ */
+static trans_table_counters * _counters(trans_table_t *t) {
+    if (__counter_idx == 0) {
+        __counter_idx = (atomic_fetch_add_explicit(&__n_counter_threads, 1,
+                    memory_order_relaxed) % TRANS_TABLE_N_COUNTERS) + 1;
+    }
+    return &t->counters[__counter_idx - 1];
+}
+
+
+/*
+ * adds 1 to the counter c, which only the calling thread writes to unless
+ * the sets of counters are being shared, so a plain load and store will do
+ */
+static void _count(_Atomic uint64_t *c) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+}
+
+
+
+int trans_table_init(trans_table_t *t, uint32_t log_n_entries) {
+    uint64_t n_entries = ((uint64_t) 1) << log_n_entries;
+
+    // an all-zero entry has check 0 and value 0, which decodes to key 0, so
+    // every slot starts out empty
+    t->entries = (trans_table_entry *)
+        calloc(n_entries, sizeof(trans_table_entry));
+    if (t->entries == NULL) {
+        return -1;
+    }
+
+    t->counters = (trans_table_counters *) aligned_alloc(CACHE_LINE,
+            TRANS_TABLE_N_COUNTERS * sizeof(trans_table_counters));
+    if (t->counters == NULL) {
+        free(t->entries);
+        return -1;
+    }
+    for (uint32_t i = 0; i < TRANS_TABLE_N_COUNTERS; i++) {
+        atomic_init(&t->counters[i].hits, 0);
+        atomic_init(&t->counters[i].misses, 0);
+        atomic_init(&t->counters[i].evictions, 0);
+    }
+
+    t->mask = n_entries - 1;
+    return 0;
+}
+
+void trans_table_destroy(trans_table_t *t) {
+    free(t->entries);
+    free(t->counters);
+}
+
+
+void trans_table_clear(trans_table_t *t) {
+    for (uint64_t i = 0; i <= t->mask; i++) {
+        atomic_store_explicit(&t->entries[i].check, 0, memory_order_relaxed);
+        atomic_store_explicit(&t->entries[i].val, 0, memory_order_relaxed);
+    }
+}
+
+
+int trans_table_lookup(trans_table_t *t, uint64_t key, uint64_t *val) {
+    trans_table_entry * e = &t->entries[key & t->mask];
+
+    uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+    uint64_t v = atomic_load_explicit(&e->val, memory_order_relaxed);
+
+    if ((check ^ v) == key) {
+        _count(&_counters(t)->hits);
+        *val = v;
+        return 1;
+    }
+    _count(&_counters(t)->misses);
+    return 0;
+}
+
+
+void trans_table_store(trans_table_t *t, uint64_t key, uint64_t val) {
+    trans_table_entry * e = &t->entries[key & t->mask];
+
+    uint64_t old_key = atomic_load_explicit(&e->check, memory_order_relaxed) ^
+        atomic_load_explicit(&e->val, memory_order_relaxed);
+    if (old_key != 0 && old_key != key) {
+        _count(&_counters(t)->evictions);
+    }
+
+    atomic_store_explicit(&e->check, key ^ val, memory_order_relaxed);
+    atomic_store_explicit(&e->val, val, memory_order_relaxed);
+}
+
+
+void trans_table_get_stats(trans_table_t *t, trans_table_stats *stats) {
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->evictions = 0;
+
+    for (uint32_t i = 0; i < TRANS_TABLE_N_COUNTERS; i++) {
+        trans_table_counters * c = &t->counters[i];
+
+        stats->hits += atomic_load_explicit(&c->hits, memory_order_relaxed);
+        stats->misses += atomic_load_explicit(&c->misses,
+                memory_order_relaxed);
+        stats->evictions += atomic_load_explicit(&c->evictions,
+                memory_order_relaxed);
+    }
+}
+
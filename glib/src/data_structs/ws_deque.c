@@ -0,0 +1,94 @@
+#include <stdlib.h>
+
+#include <data_structs/ws_deque.h>
+
+
+
+int ws_deque_init(ws_deque_t *d, uint32_t log_cap) {
+    int64_t cap = ((int64_t) 1) << log_cap;
+
+    d->buf = (_Atomic(void *) *) calloc(cap, sizeof(_Atomic(void *)));
+    if (d->buf == NULL) {
+        return -1;
+    }
+
+    d->mask = cap - 1;
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    return 0;
+}
+
+void ws_deque_destroy(ws_deque_t *d) {
+    free(d->buf);
+}
+
+
+int ws_deque_push(ws_deque_t *d, void *item) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+
+    if (b - t > d->mask) {
+        // full
+        return -1;
+    }
+
+    atomic_store_explicit(&d->buf[b & d->mask], item, memory_order_relaxed);
+    // the item (and whatever it points to) must be visible to any thief that
+    // sees the new bottom
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return 0;
+}
+
+
+void * ws_deque_pop(ws_deque_t *d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    void * item;
+
+    // reserve the bottom item before looking at top, so that a thief either
+    // sees the reservation or we see its steal
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        // empty, put bottom back
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    item = atomic_load_explicit(&d->buf[b & d->mask], memory_order_relaxed);
+
+    if (t == b) {
+        // this is the last item, so we race with thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                    memory_order_seq_cst, memory_order_relaxed)) {
+            item = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+
+    return item;
+}
+
+
+void * ws_deque_steal(ws_deque_t *d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        // empty
+        return NULL;
+    }
+
+    void * item = atomic_load_explicit(&d->buf[t & d->mask],
+            memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed)) {
+        // lost the race to another thief or the owner
+        return NULL;
+    }
+    return item;
+}
+
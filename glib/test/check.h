@@ -0,0 +1,34 @@
+#ifndef _CHECK_H
+#define _CHECK_H
+/*
+ * Checks shared by the tests, each of which is a single source file compiled
+ * into its own executable. A failed check is printed along with its line, and
+ * the test keeps going so that every failure is reported
+ */
+
+#include <stdio.h>
+
+
+static int n_failed = 0;
+
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            printf("line %d: check failed: %s\n", __LINE__, #expr); \
+            n_failed++; \
+        } \
+    } while (0)
+
+
+/*
+ * prints how many checks failed
+ *
+ * returns the exit code of the test, which is nonzero if any check failed
+ */
+static int check_report() {
+    printf("%d checks failed\n", n_failed);
+    return n_failed != 0;
+}
+
+
+#endif /* _CHECK_H */
@@ -0,0 +1,156 @@
+#include <stdio.h>
+
+#include <math/random.h>
+#include <data_structs/min_heap.h>
+#include <data_structs/radix_heap.h>
+
+#include "check.h"
+
+
+// number of nodes in the randomized comparison against the pairing heap
+#define N_NODES 5000
+
+
+/*
+ * extracts the min of h, giving its key, or -1 if h is empty
+ */
+static int64_t _extract_key(radix_heap_t *h) {
+    radix_node * node = radix_heap_extract_min(h);
+    return (node == NULL) ? -1 : (int64_t) node->key;
+}
+
+
+/*
+ * runs Dijkstra-like rounds of extracting the min and inserting or
+ * decreasing the keys of random nodes to no less than the extracted key on
+ * both a radix heap and a pairing heap, checking that they always agree
+ */
+static void _cmp_min_heap() {
+    static radix_node r_nodes[N_NODES];
+    static heap_node m_nodes[N_NODES];
+    // 0 if the node has not been inserted yet, 1 if it is in the heaps and 2
+    // if it has been extracted
+    static int state[N_NODES];
+
+    radix_heap_t r;
+    heap_t m;
+
+    radix_heap_init(&r);
+    heap_init(&m);
+    for (int i = 0; i < N_NODES; i++) {
+        state[i] = 0;
+    }
+
+    // start far from 0, so the keys span more than the low buckets
+    uint64_t last = (gen_rand() << 20) | gen_rand_r(1 << 20);
+    int i0 = gen_rand_r(N_NODES);
+    RADIX_NODE_SET(&r_nodes[i0], last);
+    HEAP_NODE_SET(&m_nodes[i0], last);
+    radix_heap_insert(&r, &r_nodes[i0]);
+    heap_insert(&m, &m_nodes[i0]);
+    state[i0] = 1;
+
+    for (int n_extracted = 0;; n_extracted++) {
+        radix_node * rn = radix_heap_extract_min(&r);
+        heap_node * mn = heap_extract_min(&m);
+
+        CHECK((rn == NULL) == (mn == NULL));
+        if (rn == NULL || mn == NULL) {
+            break;
+        }
+        CHECK(rn->key == (uint64_t) mn->key);
+        CHECK(rn->key >= last);
+        last = rn->key;
+        state[rn - r_nodes] = 2;
+
+        for (int k = 0; k < 8; k++) {
+            int j = gen_rand_r(N_NODES);
+            // mostly small steps past the last key, with some large ones
+            uint64_t key = last + ((gen_rand_r(4) == 0) ?
+                    gen_rand_r(100000) : gen_rand_r(300));
+
+            if (state[j] == 0) {
+                RADIX_NODE_SET(&r_nodes[j], key);
+                HEAP_NODE_SET(&m_nodes[j], key);
+                radix_heap_insert(&r, &r_nodes[j]);
+                heap_insert(&m, &m_nodes[j]);
+                state[j] = 1;
+            }
+            else if (state[j] == 1 && key < r_nodes[j].key) {
+                radix_heap_decrease_key(&r, &r_nodes[j], key);
+                heap_decrease_key(&m, &m_nodes[j], key);
+            }
+        }
+
+        if (n_extracted % 97 == 0) {
+            radix_heap_validate(&r);
+        }
+    }
+
+    radix_heap_destroy(&r);
+    heap_destroy(&m);
+}
+
+
+int main(int argc, char *argv[]) {
+    radix_heap_t h;
+    radix_node nodes[8];
+
+    seed_rand(0, 0);
+
+    CHECK(radix_heap_init(&h) == 0);
+
+    // an empty heap has nothing to extract
+    CHECK(radix_heap_extract_min(&h) == NULL);
+
+    // nodes come out in order of their keys
+    uint64_t keys[] = { 40, 7, 1000, 7, 63, 64, 0, 1 };
+    for (int i = 0; i < 8; i++) {
+        RADIX_NODE_SET(&nodes[i], keys[i]);
+        CHECK(radix_heap_insert(&h, &nodes[i]) == 0);
+    }
+    radix_heap_validate(&h);
+    CHECK(_extract_key(&h) == 0);
+    CHECK(_extract_key(&h) == 1);
+    CHECK(_extract_key(&h) == 7);
+    CHECK(_extract_key(&h) == 7);
+    radix_heap_validate(&h);
+
+    // keys no less than the last one extracted may still be inserted, both
+    // equal to it and between the keys already in the heap
+    RADIX_NODE_SET(&nodes[6], 7);
+    RADIX_NODE_SET(&nodes[7], 50);
+    CHECK(radix_heap_insert(&h, &nodes[6]) == 0);
+    CHECK(radix_heap_insert(&h, &nodes[7]) == 0);
+    radix_heap_validate(&h);
+    CHECK(_extract_key(&h) == 7);
+    CHECK(_extract_key(&h) == 40);
+    CHECK(_extract_key(&h) == 50);
+
+    // decreasing a key moves the node ahead of the others, whether it stays
+    // in its bucket or moves to a lower one, and a key may be decreased all
+    // the way to the last key extracted
+    RADIX_NODE_SET(&nodes[0], 1 << 20);
+    RADIX_NODE_SET(&nodes[1], (1 << 20) + 1);
+    CHECK(radix_heap_insert(&h, &nodes[0]) == 0);
+    CHECK(radix_heap_insert(&h, &nodes[1]) == 0);
+    CHECK(radix_heap_decrease_key(&h, &nodes[4], 60) == 0);
+    CHECK(radix_heap_decrease_key(&h, &nodes[2], 55) == 0);
+    CHECK(radix_heap_decrease_key(&h, &nodes[1], 50) == 0);
+    radix_heap_validate(&h);
+    CHECK(_extract_key(&h) == 50);
+    CHECK(_extract_key(&h) == 55);
+    CHECK(_extract_key(&h) == 60);
+    CHECK(_extract_key(&h) == 64);
+    CHECK(_extract_key(&h) == 1 << 20);
+    CHECK(_extract_key(&h) == -1);
+
+    radix_heap_destroy(&h);
+
+    for (int i = 0; i < 100; i++) {
+        _cmp_min_heap();
+    }
+
+    return check_report();
+}
+
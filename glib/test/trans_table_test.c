@@ -0,0 +1,132 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include <math/random.h>
+#include <data_structs/trans_table.h>
+
+#include "check.h"
+
+
+#define LOG_N_ENTRIES 10
+
+// number of threads looking up keys at once, and how many each looks up
+#define N_THREADS 4
+#define N_THREAD_LOOKUPS 100000
+
+
+static uint64_t _gen_key() {
+    uint64_t key;
+    do {
+        key = (gen_rand() << 32) | gen_rand();
+    } while (key == 0);
+    return key;
+}
+
+
+static void * _lookup_many(void *arg) {
+    trans_table_t *t = (trans_table_t *) arg;
+    uint64_t val;
+
+    for (uint64_t i = 1; i <= N_THREAD_LOOKUPS; i++) {
+        trans_table_lookup(t, i, &val);
+    }
+    return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+    trans_table_t t;
+    trans_table_stats stats;
+    uint64_t val;
+
+    seed_rand(0, 0);
+
+    CHECK(trans_table_init(&t, LOG_N_ENTRIES) == 0);
+    uint64_t n_slots = t.mask + 1;
+
+    trans_table_get_stats(&t, &stats);
+    CHECK(stats.hits == 0 && stats.misses == 0 && stats.evictions == 0);
+
+    // an empty table has nothing in it
+    for (int i = 0; i < 1000; i++) {
+        CHECK(!trans_table_lookup(&t, _gen_key(), &val));
+    }
+    trans_table_get_stats(&t, &stats);
+    CHECK(stats.hits == 0 && stats.misses == 1000 && stats.evictions == 0);
+
+    // store and lookup
+    uint64_t key = _gen_key();
+    trans_table_store(&t, key, 1234);
+    val = 0;
+    CHECK(trans_table_lookup(&t, key, &val));
+    CHECK(val == 1234);
+
+    // storing to the same key overwrites its value
+    trans_table_store(&t, key, 5678);
+    val = 0;
+    CHECK(trans_table_lookup(&t, key, &val));
+    CHECK(val == 5678);
+
+    // a different key in the same slot is not found, and replaces the old key
+    // when stored
+    uint64_t other = key + n_slots;
+    CHECK(!trans_table_lookup(&t, other, &val));
+    trans_table_store(&t, other, 42);
+    val = 0;
+    CHECK(trans_table_lookup(&t, other, &val));
+    CHECK(val == 42);
+    CHECK(!trans_table_lookup(&t, key, &val));
+
+    // so far 3 lookups found their key and 1002 did not, and the one
+    // replaced key was evicted (overwriting a key's own value is not)
+    trans_table_get_stats(&t, &stats);
+    CHECK(stats.hits == 3 && stats.misses == 1002 && stats.evictions == 1);
+
+    // a slot holding the check of one write and the value of another, as
+    // happens when two threads store to it at once, matches neither key
+    trans_table_entry * e = &t.entries[key & t.mask];
+    atomic_store(&e->check, key ^ 5678);
+    atomic_store(&e->val, 42);
+    CHECK(!trans_table_lookup(&t, key, &val));
+    CHECK(!trans_table_lookup(&t, other, &val));
+
+    // many keys at once, where later stores win each slot
+    static uint64_t keys[4096];
+    for (int i = 0; i < 4096; i++) {
+        keys[i] = _gen_key();
+        trans_table_store(&t, keys[i], i);
+    }
+    for (int i = 0; i < 4096; i++) {
+        int newest = 1;
+        for (int j = i + 1; j < 4096; j++) {
+            newest &= ((keys[j] & t.mask) != (keys[i] & t.mask));
+        }
+        int found = trans_table_lookup(&t, keys[i], &val);
+        CHECK(found == newest);
+        CHECK(!found || val == (uint64_t) i);
+    }
+
+    // clearing removes everything
+    trans_table_clear(&t);
+    for (int i = 0; i < 4096; i++) {
+        CHECK(!trans_table_lookup(&t, keys[i], &val));
+    }
+
+    trans_table_destroy(&t);
+
+    // lookups from many threads at once are each counted once
+    CHECK(trans_table_init(&t, LOG_N_ENTRIES) == 0);
+    pthread_t threads[N_THREADS];
+    for (int i = 0; i < N_THREADS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, &_lookup_many, &t) == 0);
+    }
+    for (int i = 0; i < N_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    trans_table_get_stats(&t, &stats);
+    CHECK(stats.hits == 0 &&
+            stats.misses == (uint64_t) N_THREADS * N_THREAD_LOOKUPS);
+    trans_table_destroy(&t);
+
+    return check_report();
+}
@@ -0,0 +1,147 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include <math/random.h>
+#include <data_structs/ws_deque.h>
+
+#include "check.h"
+
+
+#define LOG_CAP 4
+#define CAP (1 << LOG_CAP)
+
+// number of items pushed by the owner while thieves steal from it
+#define N_ITEMS 1000000
+#define N_THIEVES 3
+
+
+static int items[N_ITEMS];
+
+// number of times each item was taken off the deque, by the owner or a thief
+static _Atomic uint32_t n_taken[N_ITEMS];
+
+// set by the owner once it has pushed everything and emptied the deque
+static _Atomic int done;
+
+
+static void _take(void *item) {
+    if (item != NULL) {
+        atomic_fetch_add(&n_taken[(int *) item - items], 1);
+    }
+}
+
+
+static void * _thief(void *arg) {
+    ws_deque_t *d = (ws_deque_t *) arg;
+
+    while (!atomic_load(&done)) {
+        _take(ws_deque_steal(d));
+    }
+    return NULL;
+}
+
+
+/*
+ * has the owner push every item, popping some of them back off, while
+ * N_THIEVES threads steal from it, and checks that every item is taken
+ * exactly once
+ */
+static void _concurrent() {
+    ws_deque_t d;
+    pthread_t thieves[N_THIEVES];
+
+    CHECK(ws_deque_init(&d, LOG_CAP) == 0);
+    for (int i = 0; i < N_ITEMS; i++) {
+        atomic_init(&n_taken[i], 0);
+    }
+    atomic_init(&done, 0);
+
+    for (int i = 0; i < N_THIEVES; i++) {
+        CHECK(pthread_create(&thieves[i], NULL, &_thief, &d) == 0);
+    }
+
+    for (int i = 0; i < N_ITEMS; i++) {
+        while (ws_deque_push(&d, &items[i]) != 0) {
+            // full, so make room
+            _take(ws_deque_pop(&d));
+        }
+        if (gen_rand_r(4) == 0) {
+            _take(ws_deque_pop(&d));
+        }
+    }
+    // pop only fails once the deque is empty (possibly because a thief took
+    // the last item)
+    for (void *item; (item = ws_deque_pop(&d)) != NULL;) {
+        _take(item);
+    }
+    atomic_store(&done, 1);
+
+    for (int i = 0; i < N_THIEVES; i++) {
+        pthread_join(thieves[i], NULL);
+    }
+
+    uint32_t n_wrong = 0;
+    for (int i = 0; i < N_ITEMS; i++) {
+        n_wrong += (atomic_load(&n_taken[i]) != 1);
+    }
+    CHECK(n_wrong == 0);
+
+    ws_deque_destroy(&d);
+}
+
+
+int main(int argc, char *argv[]) {
+    ws_deque_t d;
+
+    seed_rand(0, 0);
+
+    CHECK(ws_deque_init(&d, LOG_CAP) == 0);
+
+    // an empty deque has nothing to pop or steal
+    CHECK(ws_deque_pop(&d) == NULL);
+    CHECK(ws_deque_steal(&d) == NULL);
+
+    // the owner pops the newest items and thieves steal the oldest
+    for (int i = 0; i < 5; i++) {
+        CHECK(ws_deque_push(&d, &items[i]) == 0);
+    }
+    CHECK(ws_deque_pop(&d) == &items[4]);
+    CHECK(ws_deque_steal(&d) == &items[0]);
+    CHECK(ws_deque_pop(&d) == &items[3]);
+    CHECK(ws_deque_steal(&d) == &items[1]);
+    CHECK(ws_deque_pop(&d) == &items[2]);
+    CHECK(ws_deque_pop(&d) == NULL);
+    CHECK(ws_deque_steal(&d) == NULL);
+
+    // the last item can be taken by either end, but only once
+    CHECK(ws_deque_push(&d, &items[5]) == 0);
+    CHECK(ws_deque_pop(&d) == &items[5]);
+    CHECK(ws_deque_steal(&d) == NULL);
+    CHECK(ws_deque_push(&d, &items[6]) == 0);
+    CHECK(ws_deque_steal(&d) == &items[6]);
+    CHECK(ws_deque_pop(&d) == NULL);
+
+    // pushing onto a full deque fails, and stealing makes room again, with
+    // the items wrapping around the buffer
+    for (int i = 0; i < CAP; i++) {
+        CHECK(ws_deque_push(&d, &items[i]) == 0);
+    }
+    CHECK(ws_deque_push(&d, &items[CAP]) != 0);
+    CHECK(ws_deque_steal(&d) == &items[0]);
+    CHECK(ws_deque_push(&d, &items[CAP]) == 0);
+    CHECK(ws_deque_push(&d, &items[CAP + 1]) != 0);
+    CHECK(ws_deque_steal(&d) == &items[1]);
+    for (int i = CAP; i >= 2; i--) {
+        CHECK(ws_deque_pop(&d) == &items[i]);
+    }
+    CHECK(ws_deque_pop(&d) == NULL);
+    CHECK(ws_deque_steal(&d) == NULL);
+
+    ws_deque_destroy(&d);
+
+    _concurrent();
+
+    return check_report();
+}
+
@@ -16,10 +16,23 @@
 #define AI_INPUT_DELAY 8
 
 
+/*
+ * flags for initializing an instance of an AI
+ */
+
+// set when the instance plays at the same time as others (each on its own
+// thread), in which case it does all of its thinking on the calling thread
+#define AI_SINGLE_THREADED 0x1
+
+// set when the instance plays the game live, in which case it never takes so
+// long to think that it holds up a frame
+#define AI_LIVE 0x2
+
+
 struct ai {
     char *name;
     int (*callback)(void* ai, tetris_state*);
-    // pointer to ai-specific struct
+    // pointer to ai-specific struct, which belongs to this instance of the AI
     void *ai_struct_ptr;
     // id starting from 0 and going up for each different AI
     int id;
@@ -27,12 +40,36 @@ struct ai {
 
 
 
-extern struct ai builtin_ais[NUM_AIS];
+/*
+ * the builtin AIs, which only describe each kind of AI. Instances which play
+ * games are made from them with ai_init
+ */
+extern const struct ai builtin_ais[NUM_AIS];
+
+
+/*
+ * gives the builtin AI with the given name, or NULL if there is none
+ */
+const struct ai * fetch_ai(const char *name);
 
+/*
+ * initializes ai as a new instance of the builtin AI type, with internal state
+ * of its own, so that any number of instances can play separate games at once
+ */
+int ai_init(struct ai * ai, const struct ai * type, int flags);
 
-struct ai * fetch_ai(char *name);
+/*
+ * control callback of a game played by an AI, to be passed to
+ * game_set_ctrl_callback with the AI as arg
+ */
+void ai_ctrl_callback(tetris_t *t, void *arg);
 
-int ai_init(struct ai * ai, game_t *g);
+/*
+ * has ai make its move for the current tick of the game s
+ */
+static int ai_go(struct ai * ai, tetris_state *s) {
+    return ai->callback(ai->ai_struct_ptr, s);
+}
 
 void ai_destroy(struct ai * ai);
 
@@ -0,0 +1,99 @@
+#ifndef _LHA_EVAL_H
+#define _LHA_EVAL_H
+
+#include <board.h>
+#include <piece.h>
+
+
+// maximum number of landing spots evaluated by one call to lha_eval_batch
+#define LHA_EVAL_BATCH 16
+
+
+// number of features in struct lha_features
+#define LHA_N_FEATURES 9
+
+// the features which are only computed when asked for, as masks with bit i
+// set for the ith feature of struct lha_features. The first four features
+// are always computed
+#define LHA_F_ROW_TRANSITIONS 0x10
+#define LHA_F_COL_TRANSITIONS 0x20
+#define LHA_F_WELL_DEPTHS     0x40
+#define LHA_F_COVERED_CELLS   0x80
+#define LHA_F_MAX_HEIGHT      0x100
+
+#define LHA_F_ALL ((1 << LHA_N_FEATURES) - 1)
+
+
+// the kernels lha_eval_batch can compute the per-column features with, from
+// slowest to fastest
+#define LHA_KERNEL_SCALAR 0
+// one landing spot per register, used on any target with SSE2
+#define LHA_KERNEL_SSE2 1
+// two landing spots per register, used when the CPU running the game supports
+// AVX2
+#define LHA_KERNEL_AVX2 2
+
+
+/*
+ * features of the board after a piece has landed on it, which the linear
+ * heuristic agent's heuristic is a weighted sum of, in this order
+ */
+struct lha_features {
+    // sum of the heights of all columns
+    uint32_t aggregate_height;
+    // number of rows which are completely filled
+    uint32_t n_complete_lines;
+    // number of empty tiles with the tile directly above them occupied
+    uint32_t n_holes;
+    // sum of absolute differences in heights of adjacent columns
+    uint32_t bumpiness;
+    // number of horizontally adjacent pairs of tiles (including the walls,
+    // which are occupied) where one is occupied and the other is empty
+    uint32_t row_transitions;
+    // number of vertically adjacent pairs of tiles (including the floor, which
+    // is occupied) where one is occupied and the other is empty
+    uint32_t col_transitions;
+    // sum over all columns lower than both of their neighbors (where the walls
+    // are infinitely high) of how much lower than the lower neighbor they are
+    uint32_t well_depths;
+    // number of empty tiles with an occupied tile somewhere above them
+    uint32_t covered_cells;
+    // height of the tallest column
+    uint32_t max_height;
+};
+
+
+/*
+ * computes the features of b with piece placed on it (piece is not actually
+ * placed on b, so it must not overlap anything on the board)
+ *
+ * of the optional features, only those in features (an or of LHA_F_*'s) are
+ * computed, and the rest are set to 0
+ */
+void lha_eval_features(board_t *b, piece_t piece, uint32_t features,
+        struct lha_features *f);
+
+/*
+ * computes the features of b with each of pieces[0..n) placed on it, one at a
+ * time, writing them to f[0..n). n may be at most LHA_EVAL_BATCH
+ *
+ * the results are identical to calling lha_eval_features on each piece, but
+ * the work which only depends on b is done once, and the per-column work is
+ * vectorized when the target supports it
+ */
+void lha_eval_batch(board_t *b, const piece_t *pieces, uint32_t n,
+        uint32_t features, struct lha_features *f);
+
+
+/*
+ * limits lha_eval_batch to the kernels no faster than kernel (one of the
+ * LHA_KERNEL_*'s), which by default is LHA_KERNEL_AVX2 so the fastest the
+ * target and CPU support is used. This is for testing each kernel, and must
+ * not be called while any evaluation is running
+ *
+ * returns the fastest kernel lha_eval_batch will now use
+ */
+int lha_eval_max_kernel(int kernel);
+
+
+#endif /* _LHA_EVAL_H */
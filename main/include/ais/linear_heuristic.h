@@ -1,19 +1,34 @@
 #ifndef _LINEAR_HEURISTIC_H
 #define _LINEAR_HEURISTIC_H
 
+#include <data_structs/trans_table.h>
+
 #include <board.h>
 #include <piece.h>
+#include <ais/lha_eval.h>
 
 
-#define N_CNSTS 4
+// one weight for each feature of struct lha_features
+#define N_CNSTS LHA_N_FEATURES
 
 
 struct lha_state {
-    // pointer to data region which is to be freed when exiting an lha_state
-    void * to_free;
-
     // list of actions to be taken, along with the times to take those actions
     struct state_node * action_list;
+
+    // queue index of the game state action_list was planned from
+    uint16_t queue_idx;
+};
+
+
+/*
+ * scratch space for the search done at each depth of the lookahead, which is
+ * allocated the first time each depth is searched and reused by every search
+ * after that. Every thread searching concurrently needs its own
+ */
+struct lha_scratch {
+    struct lha_arena * arenas;
+    int n_arenas;
 };
 
 
@@ -25,12 +40,89 @@ typedef struct linear_heuristic_agent {
     // lowers branching factor
     int best_n;
 
+    // if nonzero, search with a beam of this width instead: each ply of the
+    // lookahead keeps only the beam_width best placements over all branches
+    // (ignoring best_n), which makes the search linear in depth. Beam search
+    // is always done on the calling thread, regardless of n_threads
+    int beam_width;
+
+    // if set, every ply of the lookahead is searched with frame-accurate
+    // timing, like the top level is. Otherwise the plies below the top level
+    // only find where each piece can lock, regardless of how long it would
+    // take to get there
+    int timed_lookahead;
+
+    // if nonzero, each call to linear_heuristic_go spends at most about this
+    // many nanoseconds searching (plus the time to search one landing spot of
+    // the falling piece), and a decision is instead made over several frames
+    // by iterative deepening. The best landing spot of the deepest complete
+    // iteration is taken once the search finishes, the piece touches the
+    // ground, or max_think_frames frames have gone by. 0 searches to full
+    // depth every time a decision is needed. Beam search can only be done to
+    // full depth, so this must be 0 if beam_width is set
+    uint64_t frame_budget_ns;
+    int max_think_frames;
+
+    // if set, once the path for the falling piece is chosen, a background
+    // thread starts searching from the game state after the piece lands, so
+    // the next decision is ready when the next piece comes. The agent's
+    // parameters must not be changed while this is on
+    int ponder;
+
+    // weights of the features of struct lha_features, in the order they are
+    // declared there
     float cnsts[N_CNSTS];
 
     // internal state of AI, which is updated whenever a new falling piece is
     // grabbed or the path of a falling piece is interrupted/corrupted to where
     // the next action that should be performed is no longer clear
     struct lha_state __int_state;
+
+    // number of threads to search with (including the calling thread), read
+    // the first time a lookahead of depth greater than 1 is made. 1 means the
+    // search is done serially, without starting any threads
+    int n_threads;
+
+    // log2 of the number of entries in the transposition table, which caches
+    // the heuristic values of game states seen in the lookahead so they need
+    // not be searched again. Read the first time the agent is run, 0 disables
+    // the table. The table is kept between moves, so it must be cleared with
+    // linear_heuristic_agent_clear_tt if cnsts or best_n are changed after
+    // that
+    int tt_log_n_entries;
+
+    // log2 of the number of entries in the expansion cache, which keeps the
+    // candidate landing spots (and their heuristic values) of the game states
+    // below the top level, so that the next search can reuse the part of the
+    // lookahead it shares with this one. Read the first time the agent is
+    // run, 0 disables the cache. It is cleared along with the transposition
+    // table. Only the best few landing spots of a game state fit in an
+    // entry, so nothing is cached when best_n is -1 or more than 8, or when
+    // timed_lookahead is set
+    int xcache_log_n_entries;
+
+    // scratch space of the calling thread
+    struct lha_scratch __scratch;
+
+    // threads which split up the lookahead with the calling thread, started
+    // with the first search if n_threads > 1
+    struct lha_pool * __pool;
+
+    // transposition table, or NULL if it is disabled or not made yet
+    trans_table_t * __tt;
+
+    // buffers for beam search, made the first time it is used
+    struct lha_beam * __beam;
+
+    // expansion cache, or NULL if it is disabled or not made yet
+    struct lha_xcache * __xcache;
+
+    // decision being made over several frames, made the first time a frame
+    // budget is used
+    struct lha_decision * __decision;
+
+    // pondering thread, started the first time it is needed
+    struct lha_ponder * __ponder;
 } lha_t;
 
 
@@ -45,6 +137,19 @@ lha_t * linear_heuristic_agent_init_cnsts(const float * cnsts);
 void linear_heuristic_agent_destroy(lha_t *a);
 
 
+/*
+ * removes every entry from the agent's transposition table and expansion
+ * cache
+ */
+void linear_heuristic_agent_clear_tt(lha_t *a);
+
+/*
+ * writes the hit/miss/eviction counts of the agent's transposition table to
+ * *stats, which are all 0 if the agent has no table
+ */
+void linear_heuristic_agent_tt_stats(lha_t *a, trans_table_stats *stats);
+
+
 int linear_heuristic_go(lha_t *a, tetris_state *s);
 
 
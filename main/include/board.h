@@ -21,6 +21,55 @@
     (((n_tiles) + COLOR_IDXS_PER_INT - 1) / COLOR_IDXS_PER_INT)
 
 
+// max width of any board, so that the occupancy of each row fits in a single
+// row_mask_t and piece row masks exist for every x offset on the board
+#define BOARD_MAX_WIDTH (PIECE_MASK_N_X - PIECE_MASK_OFF)
+
+
+// max height of any board (the main game board is the tallest), storage for
+// which is held inline in every board_t so that boards can be copied by value
+#define BOARD_MAX_HEIGHT 20
+
+
+// number of board_y values a piece can be at while searching for placements,
+// which go from one bounding box below the floor to one above the top
+#define BOARD_PLACEMENT_N_Y (BOARD_MAX_HEIGHT + 2 * PIECE_BB_H)
+
+// max number of placements board_piece_placements can find
+#define BOARD_MAX_PLACEMENTS \
+    ((BOARD_MAX_WIDTH + PIECE_MASK_OFF) * BOARD_PLACEMENT_N_Y * \
+     N_PIECE_ORIENTATIONS)
+
+
+/*
+ * bitmask of the occupied tiles in a row, where bit x is set iff tile x of the
+ * row is not EMPTY
+ */
+typedef uint16_t row_mask_t;
+
+/*
+ * packed color indices of the tiles in a row, where tile x of the row is in
+ * bits [x * LOG_N_STATES, (x + 1) * LOG_N_STATES)
+ */
+typedef uint64_t row_colors_t;
+
+
+/*
+ * gives the pairs of horizontally adjacent tiles in row where one is occupied
+ * and the other is empty, where the walls on either side count as occupied,
+ * as a mask with bit x set for the pair left of column x
+ */
+static uint32_t board_row_transition_bits(row_mask_t row,
+        row_mask_t full_row) {
+    // the row shifted over by one, with a wall on either side
+    uint32_t walled = (((uint32_t) row & full_row) << 1) | 1 |
+        (((uint32_t) full_row + 1) << 1);
+    uint32_t pairs = ((uint32_t) full_row << 1) | 1;
+
+    return (walled ^ (walled >> 1)) & pairs;
+}
+
+
 #define BOARD_DO_GRAPHICS 0x1
 #define BOARD_CHANGED 0x2
 #define BOARD_GRAYED 0x4
@@ -28,7 +77,7 @@
 
 
 /*
- * bit to set in color_idxs to mark tile as shadow
+ * bit to set in a tile's color index to mark tile as shadow
  */
 #define PIECE_SHADOW 0x8
 
@@ -37,8 +86,49 @@ typedef struct board {
     // tile prototype shape (will be instanced)
     shape tile_prot;
 
-    // packed color indices for each tile
-    uint32_t *color_idxs;
+    // packed color indices of each row, which are not kept in order but are
+    // addressed through row_map, so that rows can be cleared or shifted by
+    // only permuting row_map
+    row_colors_t row_colors[BOARD_MAX_HEIGHT];
+
+    // index into row_colors of each row of the board, from the bottom up
+    uint8_t row_map[BOARD_MAX_HEIGHT];
+
+    // occupancy bitmask of each row (in board order, not through row_map),
+    // kept in sync with row_colors so that collision and full row checks can
+    // be done a whole row at a time
+    row_mask_t row_masks[BOARD_MAX_HEIGHT];
+
+    // row mask of a row with every tile filled
+    row_mask_t full_row;
+
+    // number of rows which are completely filled
+    uint8_t n_full_rows;
+
+    // height of each column, which is one more than the row of the topmost
+    // occupied tile in the column (or 0 if the column is empty)
+    uint8_t col_heights[BOARD_MAX_WIDTH];
+
+    // number of holes in each column, where a hole is an empty tile with the
+    // tile directly above it occupied
+    uint8_t col_holes[BOARD_MAX_WIDTH];
+
+    // number of occupied tiles
+    uint16_t n_filled;
+
+    // number of horizontally adjacent pairs of tiles where one is occupied and
+    // the other is empty, where the walls count as occupied
+    uint16_t row_transitions;
+
+    // number of vertically adjacent pairs of tiles where one is occupied and
+    // the other is empty, where the floor counts as occupied and the top of the
+    // board is not counted
+    uint16_t col_transitions;
+
+    // Zobrist-style hash of the occupancy of the board, which is the xor of
+    // a key for each row that depends on the row's index and mask (empty rows
+    // have key 0)
+    uint64_t hash;
 
     // width and height of board, in tiles
     uint32_t width, height;
@@ -73,6 +163,10 @@ void board_destroy(board_t *b);
  * makes a deep copy of the baord. The original board MUST be destroyed after
  * all of its copies are destroyed, if a copy is used after the original was
  * destroyed, the behavior is undefined
+ *
+ * since all tiles are stored inline, this never allocates, and copying a
+ * board_t by value is an equally independent copy of its tiles (only without
+ * the BOARD_COPY flag set)
  */
 void board_deep_copy(board_t *dst, const board_t *src);
 
@@ -142,17 +236,104 @@ uint8_t board_get_tile(board_t *b, int32_t x, int32_t y);
 int board_row_full(board_t *b, int32_t row);
 
 
+/*
+ * the following give the column statistics which are kept up to date as tiles
+ * are placed and rows are cleared, so reading them is O(1)
+ */
+
+/*
+ * gives one more than the row of the topmost occupied tile in column col, or 0
+ * if the column is empty
+ */
+static uint32_t board_col_height(board_t *b, int32_t col) {
+    return b->col_heights[col];
+}
+
+/*
+ * gives the number of empty tiles in column col with an occupied tile directly
+ * above them
+ */
+static uint32_t board_col_holes(board_t *b, int32_t col) {
+    return b->col_holes[col];
+}
+
+/*
+ * gives the number of rows of the board which are completely filled
+ */
+static uint32_t board_num_full_rows(board_t *b) {
+    return b->n_full_rows;
+}
 
 /*
- * copies the entirety of src_row into dst_row
- * TODO optimize
+ * gives the number of occupied tiles on the board
+ */
+static uint32_t board_num_filled(board_t *b) {
+    return b->n_filled;
+}
+
+/*
+ * gives the number of horizontally adjacent pairs of tiles where one is
+ * occupied and the other is empty (the walls count as occupied)
+ */
+static uint32_t board_row_transitions(board_t *b) {
+    return b->row_transitions;
+}
+
+/*
+ * gives the number of vertically adjacent pairs of tiles where one is occupied
+ * and the other is empty (the floor counts as occupied)
+ */
+static uint32_t board_col_transitions(board_t *b) {
+    return b->col_transitions;
+}
+
+/*
+ * gives a 64-bit hash of which tiles of the board are occupied (the colors of
+ * the tiles are not included). Boards with the same occupancy always have the
+ * same hash, and an empty board has hash 0
+ */
+static uint64_t board_hash(board_t *b) {
+    return b->hash;
+}
+
+
+
+/*
+ * copies the entirety of src_row into dst_row (both must be on the board)
  */
 void board_copy_row(board_t *b, int32_t dst_row, int32_t src_row);
 
 
+/*
+ * empties every tile of row (which must be on the board)
+ */
 void board_clear_row(board_t *b, int32_t row);
 
 
+/*
+ * removes each row start_row + i for which bit i of rows is set, dropping the
+ * rows above them down to fill the gaps and filling the top of the board with
+ * empty rows
+ *
+ * no tiles are copied, the rows are only reordered in row_map
+ */
+void board_remove_rows(board_t *b, int32_t start_row, uint32_t rows);
+
+
+/*
+ * pushes every row of the board up by n_rows, discarding the top n_rows rows,
+ * and fills the n_rows new rows at the bottom with tile_color at each tile
+ * whose bit is set in tiles (e.g. garbage rows with a gap in them)
+ *
+ * like board_remove_rows, this only reorders row_map
+ *
+ * returns 1 if any occupied tiles were pushed off the top of the board,
+ * otherwise 0
+ */
+int board_insert_rows(board_t *b, uint32_t n_rows, row_mask_t tiles,
+        uint32_t tile_color);
+
+
 
 
 /*
@@ -184,6 +365,39 @@ void board_remove_piece(board_t *b, piece_t piece);
 int board_piece_collides(board_t *b, piece_t piece);
 
 
+/*
+ * gives the board_y the piece would come to rest at if it were dropped
+ * straight down from where it is. The piece must not be on the board
+ *
+ * when the piece is above the surface of every column it spans, this is found
+ * in one step from the column heights and the piece's per-column bottom
+ * offsets, otherwise the piece is moved down one row at a time until it
+ * collides
+ */
+int32_t board_landing_row(board_t *b, piece_t piece);
+
+
+/*
+ * finds every position the piece could lock in by moving it left, right and
+ * down and rotating it (with SRS wall kicks) from where it is, any number of
+ * times and regardless of how long that would take. The piece must not be on
+ * the board
+ *
+ * this is a flood fill over (x, y, orientation), done a whole row of x values
+ * at a time with bitmasks of the positions the piece fits in, so no game
+ * state is simulated. Wall kicks are resolved like tetris_pose_rotate does,
+ * with the rows above the board empty, and a piece kicked above the rows
+ * searched is taken to fall back down to the highest of them
+ *
+ * the positions are written to placements, which must have room for
+ * BOARD_MAX_PLACEMENTS pieces, ordered by orientation, then board_y, then
+ * board_x. Returns the number of positions, which is 0 if the piece does not
+ * fit where it is
+ */
+uint32_t board_piece_placements(board_t *b, piece_t piece,
+        piece_t *placements);
+
+
 void board_draw(board_t *b);
 
 
@@ -0,0 +1,71 @@
+#ifndef _HEADLESS_H
+#define _HEADLESS_H
+
+#include <stdint.h>
+
+#include <tetris_state.h>
+
+
+/*
+ * helpers for the tools which play many games without graphics
+ */
+
+
+// default number of ticks after which a headless game is stopped if it has
+// not ended, same as the main game's quiet mode
+#define HEADLESS_DEFAULT_MAX_TICKS 500000
+
+
+/*
+ * result of one headless game
+ */
+struct headless_result {
+    int32_t score;
+    int32_t lines;
+    uint32_t level;
+    // number of pieces that were spawned
+    uint64_t pieces;
+    uint64_t ticks;
+    // set if the game ended by topping out, rather than by running out of
+    // time
+    int over;
+};
+
+
+/*
+ * plays one game from the given seed and level without graphics, the way the
+ * game does in quiet mode, calling go with agent every tick to make its moves.
+ * The game is stopped after max_ticks ticks if it hasn't ended by then
+ *
+ * the game seeds the calling thread's random number generator
+ */
+void headless_play(uint64_t seed, uint32_t level, uint64_t max_ticks,
+        int (*go)(void *agent, tetris_state *s), void *agent,
+        struct headless_result *res);
+
+
+/*
+ * calls job(arg, i) for every i from 0 to n_jobs - 1 on n_threads new threads,
+ * each job being taken by whichever thread gets to it first. The calling
+ * thread only waits for them, so its random number generator is left alone
+ */
+void headless_run_jobs(uint32_t n_jobs, uint32_t n_threads,
+        void (*job)(void *arg, uint32_t i), void *arg);
+
+
+/*
+ * parses arg as a base 10 unsigned number of at most max into *res
+ *
+ * returns 0 on success, or prints an error and returns -1 if arg is not a
+ * number or is out of range
+ */
+int headless_parse_u64(const char *arg, uint64_t max, uint64_t *res);
+
+/*
+ * prints the usage of the program named prog, which takes the given options,
+ * and returns -1
+ */
+int headless_usage(const char *prog, const char *opts);
+
+
+#endif /* _HEADLESS_H */
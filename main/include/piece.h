@@ -224,63 +224,84 @@ const extern struct piece_layout pieces[N_PIECES];
         (piece).board_x, (piece).board_y)
 
 
+// number of displacements tried when rotating a piece, in order, the first of
+// which the piece fits at being where it ends up
+#define N_KICK_TRIALS 5
+
+// the J, L, S, T, and Z tetrominoes share one set of wall kicks, and the I
+// tetromino has its own
+#define N_KICK_CLASSES 2
+
+#define PIECE_KICK_CLASS(tile_idx) ((tile_idx) == PIECE_I)
+
+// counterclockwise rotations are direction 0, and clockwise are direction 1
+#define N_ROTATE_DIRS 2
+
+#define PIECE_KICK_DIR(rot) (((rot) + 1) >> 1)
+
+typedef struct piece_kick {
+    int8_t dx;
+    int8_t dy;
+} piece_kick_t;
+
 /*
- * data encoding which displacements to try placing a piece at when rotated,
- * for J, L, S, T, and Z tetrominoes
+ * displacements to try placing a piece at when rotated, indexed by
+ * [PIECE_KICK_CLASS(piece_idx)][orientation before rotating]
+ * [PIECE_KICK_DIR(rotation)][trial]
+ *
+ * these are computed at compile time from the SRS tables in piece.c
  */
-const extern uint32_t displacement_trial_data[8];
+const extern piece_kick_t piece_kicks[N_KICK_CLASSES][N_PIECE_ORIENTATIONS]
+    [N_ROTATE_DIRS][N_KICK_TRIALS];
+
 
 /*
- * data encoding which displacements to try placing the I tetromino at when
- * rotated
+ * bit offset of column 0 of the board in piece row masks, which leaves room
+ * for pieces whose bounding box hangs off the left side of the board
  */
-const extern uint32_t displacement_trial_data_I[16];
-
-// given the previous orientation and rotation direction, gets the displacement
-// vector index from displacement_trial_data_I
-#define dtdI_idx_x(prev_or, rot) \
-    (2 * (2 * (prev_or) + (((rot) >> 1) + 1)))
+#define PIECE_MASK_OFF 4
 
-#define dtdI_idx_y(prev_or, rot) \
-    (dtdI_idx_x(prev_or, rot) + 1)
+// number of x offsets piece row masks are precomputed for, with board_x
+// ranging from -PIECE_MASK_OFF up to 16 (the widest board)
+#define PIECE_MASK_N_X (PIECE_MASK_OFF + 16)
 
 /*
- * computes the difference between row1 and row2 from the displacement
- * trial data table
+ * occupancy bitmasks of each row of the bounding box of each piece in each
+ * orientation, pre-shifted to each x offset, indexed by
+ * [piece_idx - 1][orientation][board_x + PIECE_MASK_OFF][row]
+ *
+ * these are computed at compile time from the piece layouts
  */
-static uint32_t sub_rows(uint32_t row1, uint32_t row2) {
-    const uint32_t pad_mask = 0x77777;
+const extern uint32_t piece_masks[N_PIECES][N_PIECE_ORIENTATIONS]
+    [PIECE_MASK_N_X][PIECE_BB_H];
 
-    uint32_t neg_row2 = ((~row2) & pad_mask) + 0x11111;
 
-    return row1 + neg_row2;
-}
+// bottom offset of a column of a piece's bounding box which has no tiles in it
+#define PIECE_COL_EMPTY PIECE_BB_H
 
-static int8_t sign_extend_3_bit(uint32_t val) {
-    return (int8_t) ((((int32_t) val) << 29) >> 29);
-}
+/*
+ * row of the lowest tile in each column of the bounding box of each piece in
+ * each orientation (relative to the bottom of the bounding box), or
+ * PIECE_COL_EMPTY if there are no tiles in that column, indexed by
+ * [piece_idx - 1][orientation][column]
+ *
+ * these are computed at compile time from the piece layouts
+ */
+const extern uint8_t piece_col_bottoms[N_PIECES][N_PIECE_ORIENTATIONS]
+    [PIECE_BB_W];
 
 
+/*
+ * iterates (dx, dy) over the displacements to try placing a piece of type
+ * tile_idx at after rotating it from orientation prev_or in direction rot
+ */
 #define for_each_displacement_trial(tile_idx, prev_or, rot, dx, dy) \
-    uint32_t __x_row, __y_row; \
-    if ((tile_idx) == PIECE_I) { \
-        __x_row = displacement_trial_data_I[dtdI_idx_x(prev_or, rot)]; \
-        __y_row = displacement_trial_data_I[dtdI_idx_y(prev_or, rot)]; \
-    } \
-    else { \
-        __x_row = sub_rows( \
-                displacement_trial_data[2 * (prev_or)], \
-                displacement_trial_data[2 * (((prev_or) + (rot)) & 0x3)]); \
-        __y_row = sub_rows( \
-                displacement_trial_data[1 + 2 * (prev_or)], \
-                displacement_trial_data[1 + 2 * (((prev_or) + (rot)) & 0x3)]); \
-    } \
-    uint8_t __cnt = 0; \
-    for (dx = sign_extend_3_bit(__x_row & 0x7), dy = sign_extend_3_bit(__y_row & 0x7); \
-            __cnt < 5; \
-            __cnt++, __x_row >>= 4, __y_row >>= 4, \
-            dx = sign_extend_3_bit(__x_row & 0x7), \
-            dy = sign_extend_3_bit(__y_row & 0x7))
+    for (const piece_kick_t *__kick = piece_kicks[PIECE_KICK_CLASS(tile_idx)] \
+                [prev_or][PIECE_KICK_DIR(rot)], \
+            *__kick_end = __kick + N_KICK_TRIALS; \
+            __kick != __kick_end && \
+                ((dx) = __kick->dx, (dy) = __kick->dy, 1); \
+            __kick++)
 
 
 
@@ -347,6 +368,29 @@ static void piece_rotate(piece_t *p, int rotation) {
     p->orientation = (p->orientation + rotation) & 0x3;
 }
 
+/*
+ * gives the occupancy bitmask of each of the PIECE_BB_H rows of the piece's
+ * bounding box, with element 0 being row p.board_y. Column x of the board is
+ * bit x + PIECE_MASK_OFF of each mask
+ *
+ * board_x must be in the range [-PIECE_MASK_OFF,
+ * PIECE_MASK_N_X - PIECE_MASK_OFF)
+ */
+static const uint32_t * piece_row_masks(piece_t p) {
+    return piece_masks[p.piece_idx - 1][p.orientation]
+        [p.board_x + PIECE_MASK_OFF];
+}
+
+/*
+ * gives the row of the lowest tile in each of the PIECE_BB_W columns of the
+ * piece's bounding box, relative to p.board_y, or PIECE_COL_EMPTY for columns
+ * without any tiles
+ */
+static const uint8_t * piece_bottom_offsets(piece_t p) {
+    return piece_col_bottoms[p.piece_idx - 1][p.orientation];
+}
+
+
 /*
  * gives number of unique ways a piece can be oriented
  */
@@ -27,6 +27,11 @@ struct tetris_state;
 // set if the falling piece is not actually placed on the board
 #define TRANSIENT_STATE 0x1
 
+// set on copies of the game made to look ahead at future moves, so that
+// refilling their piece queue does not draw from the random number generator
+// (the game's own piece sequence must not depend on what the AI searched)
+#define LOOKAHEAD_STATE 0x2
+
 
 /*
  * falling piece flags
@@ -42,8 +47,8 @@ struct tetris_state;
 // delay)
 #define DESIRED_MINOR_TICK_SPEED 4
 
-// default avg. # frames between callbacks to held-down keys
-#define DEFAULT_HELD_KEY_PERIOD 4.
+// default # frames between callbacks to held-down keys
+#define DEFAULT_HELD_KEY_PERIOD 4
 
 // max number of times we allow the tile to hit into the ground before locking
 // it there anyway (so you can't rotate forever and never place a tile)
@@ -267,24 +272,57 @@ typedef struct tetris_state {
     // time counter, starts at 0 and is incremented every frame
     uint64_t time;
 
-    // frames per step of animation (60 fps, so if major tick count is 60,
-    // then the game advances by one step every second)
-    // a frame is counted if (time / tick_count) 
-    float major_tick_count;
-    float major_tick_time;
-    // minor tick count is always an integer quotient of major tick count, so
-    // we use major tick time mod minor tick count to check if it is a minor
-    // time step
-    float minor_tick_count;
+    // number of pieces taken from the queue so far, including the falling
+    // piece
+    uint64_t n_pieces;
+
+    // the schedule of major and minor time steps is kept in units of
+    // 1 / tick_den frames, which is chosen with the falling speed so that
+    // both periods are a whole number of units. All of the arithmetic on it is
+    // done with integers, so it is exact
+    uint32_t tick_den;
+
+    // units per step of animation (60 fps, so if major tick count is
+    // 60 * tick_den, then the game advances by one step every second)
+    uint32_t major_tick_count;
+    // units since the last major time step, which is negative during "dead
+    // time", a short pause before the next one
+    int32_t major_tick_time;
+    // minor tick count always evenly divides major tick count, so we use major
+    // tick time mod minor tick count to check if it is a minor time step
+    uint32_t minor_tick_count;
 
     // frames between calls to key callbacks (i.e. how fast a held down key
     // will be pressed)
-    float key_callback_count;
-    float key_callback_time;
+    uint32_t key_callback_count;
+    uint32_t key_callback_time;
 
 } tetris_state;
 
 
+/*
+ * the parts of a tetris_state which change while the falling piece is being
+ * controlled, up until it sticks. The tetris_pose_* functions below move a
+ * pose around against a tetris_state, of which they only read the board and
+ * tick counts, so many poses can be explored from one state without copying
+ * the rest of it
+ */
+typedef struct tetris_pose {
+    // see the corresponding fields in tetris_state
+    uint64_t time;
+    int32_t major_tick_time;
+    uint32_t key_callback_time;
+
+    piece_t falling_piece;
+    falling_piece_data fp_data;
+
+    uint8_t state;
+
+    // status flags of the scorer (see scorer_t)
+    uint8_t scorer_status;
+} tetris_pose;
+
+
 /*
  * initialize tetris state without graphical capabilities
  */
@@ -300,15 +338,48 @@ void tetris_state_init5(tetris_state *state, float x,
 void tetris_state_destroy(tetris_state *state);
 
 
+/*
+ * copies src into dst by value. The board's tiles are stored inline, so this
+ * is already an independent copy of the board, though dst's board is not
+ * marked as a copy
+ */
 void tetris_state_shallow_copy(tetris_state *dst, tetris_state *src);
 
 
+/*
+ * copies src into dst, marking dst's board as a copy (see board_deep_copy).
+ * This does not allocate
+ */
 void tetris_state_deep_copy(tetris_state *dst, tetris_state *src);
 
 
 int tetris_state_is_transient(tetris_state *state);
 
 
+/*
+ * gives a 64-bit key of the position of the game, combining the occupancy of
+ * the board (see board_hash) with the falling piece, the hold and the index
+ * into the piece queue. This is O(1), since the board hash is kept up to date
+ * as the board changes
+ *
+ * the falling piece should be off the board (i.e. the state is transient), and
+ * keys are only comparable between states of the same game, since queue_idx
+ * does not identify which pieces are in the queue
+ */
+uint64_t tetris_state_hash(tetris_state *state);
+
+
+/*
+ * copies the pose of s into pose
+ */
+void tetris_pose_get(tetris_pose *pose, const tetris_state *s);
+
+/*
+ * overwrites the pose of s with pose
+ */
+void tetris_pose_set(tetris_state *s, const tetris_pose *pose);
+
+
 void tetris_place_falling_piece(tetris_state *state);
 
 void tetris_remove_falling_piece(tetris_state *state);
@@ -318,10 +389,10 @@ int tetris_game_is_over(tetris_state *state);
 
 
 /*
- * sets falling speed of the game (period is average number of frames between
+ * sets falling speed of the game (period is the number of frames between
  * major time steps)
  */
-void tetris_set_falling_speed(tetris_state *s, double period);
+void tetris_set_falling_speed(tetris_state *s, uint32_t period);
 
 
 /*
@@ -368,6 +439,11 @@ int tetris_move_piece(tetris_state *state, int dx, int dy);
  */
 int tetris_move_piece_transient(tetris_state *state, int dx, int dy);
 
+/*
+ * same as move_piece_transient, but moves pose instead of the pose of state
+ */
+int tetris_pose_move(tetris_state *state, tetris_pose *pose, int dx, int dy);
+
 
 /*
  * rotate the following piece either clockwise or counterclockwise, depending
@@ -390,6 +466,13 @@ int tetris_rotate_piece(tetris_state *state, int rotation,
 int tetris_rotate_piece_transient(tetris_state *state,
         int rotation, int allow_wall_kicks);
 
+/*
+ * same as rotate_piece_transient, but rotates pose instead of the pose of
+ * state
+ */
+int tetris_pose_rotate(tetris_state *state, tetris_pose *pose, int rotation,
+        int allow_wall_kicks);
+
 
 /*
  * performs hold action, which takes the currently falling piece and places it
@@ -451,6 +534,9 @@ void tetris_tick(tetris_state *s);
  */
 int tetris_advance_by_transient(tetris_state *state, uint64_t *ticks);
 
+int tetris_pose_advance_by(tetris_state *state, tetris_pose *pose,
+        uint64_t *ticks);
+
 
 /*
  * advances the game state until the falling piece either falls by one tile or
@@ -461,6 +547,8 @@ int tetris_advance_by_transient(tetris_state *state, uint64_t *ticks);
  */
 int tetris_advance_until_drop_transient(tetris_state *state);
 
+int tetris_pose_advance_until_drop(tetris_state *state, tetris_pose *pose);
+
 
 
 
@@ -474,6 +562,10 @@ int tetris_is_major_time_step(tetris_state *s);
 
 int tetris_is_minor_time_step(tetris_state *s);
 
+int tetris_pose_is_major_time_step(tetris_state *s, const tetris_pose *pose);
+
+int tetris_pose_is_minor_time_step(tetris_state *s, const tetris_pose *pose);
+
 int tetris_is_key_callback_step(tetris_state *s);
 
 /*
@@ -489,6 +581,9 @@ void tetris_advance_to_next_action(tetris_state *s);
  */
 int tetris_advance_to_next_minor_time_step(tetris_state *s);
 
+int tetris_pose_advance_to_next_minor_time_step(tetris_state *s,
+        tetris_pose *pose);
+
 
 
 // could not advance game state (game over)
@@ -518,6 +613,8 @@ int tetris_advance(tetris_state *s);
  */
 int tetris_advance_transient(tetris_state *s);
 
+int tetris_pose_advance(tetris_state *s, tetris_pose *pose);
+
 
 /*
  * advnaces game state by complete step, fetching new falling piece from the
@@ -2,7 +2,9 @@
 #define _TUTIL_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <print_colors.h>
 #include <stdio.h>
@@ -22,4 +24,31 @@
 
 
 
+/*
+ * scrambles the bits of x (the splitmix64 finalizer), so that distinct inputs
+ * give well distributed, practically collision-free 64-bit keys. This is used
+ * in place of tables of random numbers for Zobrist-style hashing
+ */
+static uint64_t tetris_hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9LU;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebLU;
+    x ^= x >> 31;
+    return x;
+}
+
+
+/*
+ * gives the time in nanoseconds on a monotonic clock, for measuring how long
+ * things take
+ */
+static uint64_t tetris_time_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000LU + ts.tv_nsec;
+}
+
+
 #endif /* _TUTIL_H */
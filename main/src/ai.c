@@ -10,7 +10,12 @@
 #define LINEAR_HEURISTIC_ID 1
 
 
-struct ai builtin_ais[NUM_AIS] = {
+// time the linear heuristic AI may spend searching each frame when playing in
+// the game, so that it never holds up drawing
+#define LIVE_FRAME_BUDGET_NS 2000000
+
+
+const struct ai builtin_ais[NUM_AIS] = {
     {
         .name = "basic",
         .callback = &basic_go,
@@ -24,7 +29,7 @@ struct ai builtin_ais[NUM_AIS] = {
 };
 
 
-struct ai * fetch_ai(char *name) {
+const struct ai * fetch_ai(const char *name) {
     for (int i = 0; i < NUM_AIS; i++) {
         if (strcmp(builtin_ais[i].name, name) == 0) {
             return &builtin_ais[i];
@@ -35,16 +40,14 @@ struct ai * fetch_ai(char *name) {
 
 
 
-static void callback(tetris_t *t, void *arg) {
+void ai_ctrl_callback(tetris_t *t, void *arg) {
     struct ai * ai = (struct ai *) arg;
-    tetris_state * s = &t->game_state;
-    ai->callback(ai->ai_struct_ptr, s);
+    ai_go(ai, &t->game_state);
 }
 
 
-int ai_init(struct ai * ai, game_t *g) {
-
-    game_set_ctrl_callback(g, &callback, (void*) ai);
+int ai_init(struct ai * ai, const struct ai * type, int flags) {
+    *ai = *type;
 
     switch (ai->id) {
         case BASIC_ID:
@@ -52,6 +55,16 @@ int ai_init(struct ai * ai, game_t *g) {
             break;
         case LINEAR_HEURISTIC_ID:
             ai->ai_struct_ptr = linear_heuristic_agent_init();
+            if (flags & AI_SINGLE_THREADED) {
+                ((lha_t *) ai->ai_struct_ptr)->n_threads = 1;
+            }
+            if (flags & AI_LIVE) {
+                // think within each frame, and in the background between
+                // pieces
+                ((lha_t *) ai->ai_struct_ptr)->frame_budget_ns =
+                    LIVE_FRAME_BUDGET_NS;
+                ((lha_t *) ai->ai_struct_ptr)->ponder = 1;
+            }
             break;
     }
 
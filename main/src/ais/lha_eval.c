@@ -0,0 +1,499 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+// the AVX2 intrinsics are declared whatever the target, and are only used in
+// the functions compiled for AVX2 below
+#include <immintrin.h>
+#endif
+
+#include <util.h>
+
+#include <tetris.h>
+#include <ais/lha_eval.h>
+#include <tutil.h>
+
+
+// the per-column work is done on one byte per column, 16 columns at a time
+#define N_COL_LANES 16
+
+#if TETRIS_WIDTH > N_COL_LANES
+#error "column features are computed with one byte lane per column"
+#endif
+
+// height of the walls on either side of the board when finding wells
+#define WALL_HEIGHT 0xff
+
+// masks of tiles or pairs of tiles in a row are at most this many bits (one
+// pair per column plus the pair with the right wall), so counting the bits
+// set in all the rows around a piece takes only one popcount when the rows are
+// packed into a word this many bits apart
+#define PACK_STRIDE (TETRIS_WIDTH + 1)
+#define PACK_N (64 / PACK_STRIDE)
+
+#define _PACK(mask, i) (((uint64_t) (mask)) << ((i) * PACK_STRIDE))
+
+#if PIECE_BB_H + 1 > PACK_N
+#error "the rows around a piece must fit in one packed word"
+#endif
+
+
+/*
+ * the parts of the features which only depend on the board
+ */
+struct eval_base {
+    // height of each column, with columns past the edge of the board 0
+    uint8_t heights[N_COL_LANES] __attribute__((aligned(16)));
+    // the optional features to compute (LHA_F_*'s)
+    uint32_t features;
+    uint32_t n_holes;
+    uint32_t n_complete_lines;
+    uint32_t row_transitions;
+    uint32_t col_transitions;
+    // number of occupied tiles
+    uint32_t n_filled;
+};
+
+
+/*
+ * the parts of the features which depend on the piece, besides those computed
+ * column by column
+ */
+struct eval_piece {
+    // height each column would be raised to by the piece alone, or 0 if the
+    // piece does not cover the column
+    uint8_t heights[N_COL_LANES] __attribute__((aligned(16)));
+    uint32_t n_holes;
+    uint32_t n_complete_lines;
+    uint32_t row_transitions;
+    uint32_t col_transitions;
+    uint32_t n_filled;
+};
+
+
+/*
+ * gives the occupancy of row y of the board, where rows above the board are
+ * empty
+ */
+static row_mask_t _board_row(board_t *b, int8_t y) {
+    return y < (int8_t) b->height ? b->row_masks[y] : 0;
+}
+
+
+static void _eval_base(board_t *b, uint32_t features,
+        struct eval_base *base) {
+    memset(base->heights, 0, sizeof(base->heights));
+    base->features = features;
+    base->n_holes = 0;
+
+    // start from the statistics of the board, which are maintained as the
+    // board changes
+    for (int8_t col = 0; col < TETRIS_WIDTH; col++) {
+        base->heights[col] = board_col_height(b, col);
+        base->n_holes += board_col_holes(b, col);
+    }
+    base->n_complete_lines = board_num_full_rows(b);
+    base->row_transitions = board_row_transitions(b);
+    base->col_transitions = board_col_transitions(b);
+    base->n_filled = board_num_filled(b);
+}
+
+
+/*
+ * accounts for piece, which is not on the board, in everything but the column
+ * features, and finds how high it raises each column it covers
+ */
+static void _eval_piece(board_t *b, piece_t piece,
+        const struct eval_base *base, struct eval_piece *p) {
+
+    // occupancy of the rows from one below the piece's bounding box to one
+    // above it, both without (b_rows) and with (m_rows) the piece placed on
+    // the board
+    row_mask_t b_rows[PIECE_BB_H + 2];
+    row_mask_t m_rows[PIECE_BB_H + 2];
+
+    row_mask_t full_row = b->full_row;
+    uint32_t features = base->features;
+
+    // masks of the tiles of the piece on the board and the row transitions in
+    // the rows of the piece, packed into one word each
+    uint64_t filled = 0;
+    uint64_t m_rt = 0, b_rt = 0;
+
+    memset(p->heights, 0, sizeof(p->heights));
+    p->n_complete_lines = base->n_complete_lines;
+
+    const uint32_t *masks = piece_row_masks(piece);
+    int8_t y0 = piece.board_y - 1;
+
+    for (int8_t r = 0; r < PIECE_BB_H + 2; r++) {
+        int8_t y = y0 + r;
+        row_mask_t piece_row = (r == 0 || r == PIECE_BB_H + 1) ? 0 :
+            (masks[r - 1] >> PIECE_MASK_OFF) & full_row;
+
+        b_rows[r] = (y >= 0) ? _board_row(b, y) : full_row;
+        m_rows[r] = b_rows[r] | piece_row;
+
+        if (y >= 0 && y < TETRIS_HEIGHT && piece_row != 0) {
+            // rows go from the bottom up, so the last row of the piece to
+            // cover a column is the highest
+            for (uint32_t cols = piece_row; cols != 0; cols &= cols - 1) {
+                p->heights[__builtin_ctz(cols)] = y + 1;
+            }
+
+            p->n_complete_lines += (b_rows[r] != full_row &&
+                    m_rows[r] == full_row);
+
+            filled |= _PACK(piece_row, r - 1);
+            if (features & LHA_F_ROW_TRANSITIONS) {
+                m_rt |= _PACK(board_row_transition_bits(m_rows[r], full_row),
+                        r - 1);
+                b_rt |= _PACK(board_row_transition_bits(b_rows[r], full_row),
+                        r - 1);
+            }
+        }
+    }
+
+    // only holes and column transitions between the rows below and in the
+    // piece can have changed
+    uint64_t m_holes = 0, b_holes = 0;
+    uint64_t m_ct = 0, b_ct = 0;
+
+    for (int8_t r = 0; r < PIECE_BB_H + 1; r++) {
+        int8_t y = y0 + r;
+
+        if (y >= 0 && y < TETRIS_HEIGHT) {
+            m_holes |= _PACK(~m_rows[r] & m_rows[r + 1] & full_row, r);
+            b_holes |= _PACK(~b_rows[r] & b_rows[r + 1] & full_row, r);
+        }
+        if ((features & LHA_F_COL_TRANSITIONS) &&
+                y + 1 >= 0 && y + 1 < TETRIS_HEIGHT) {
+            m_ct |= _PACK((m_rows[r] ^ m_rows[r + 1]) & full_row, r);
+            b_ct |= _PACK((b_rows[r] ^ b_rows[r + 1]) & full_row, r);
+        }
+    }
+
+    p->n_holes = base->n_holes + __builtin_popcountll(m_holes) -
+        __builtin_popcountll(b_holes);
+    p->row_transitions = (features & LHA_F_ROW_TRANSITIONS) ?
+        base->row_transitions + __builtin_popcountll(m_rt) -
+        __builtin_popcountll(b_rt) : 0;
+    p->col_transitions = (features & LHA_F_COL_TRANSITIONS) ?
+        base->col_transitions + __builtin_popcountll(m_ct) -
+        __builtin_popcountll(b_ct) : 0;
+    p->n_filled = base->n_filled + __builtin_popcountll(filled);
+}
+
+
+/*
+ * the column features of the board with a piece placed on it
+ */
+struct eval_cols {
+    uint32_t aggregate_height;
+    uint32_t bumpiness;
+    uint32_t well_depths;
+    uint32_t max_height;
+};
+
+
+static void _eval_finish(const struct eval_base *base,
+        const struct eval_piece *p, const struct eval_cols *c,
+        struct lha_features *f) {
+    f->aggregate_height = c->aggregate_height;
+    f->n_complete_lines = p->n_complete_lines;
+    f->n_holes = p->n_holes;
+    f->bumpiness = c->bumpiness;
+    f->row_transitions = p->row_transitions;
+    f->col_transitions = p->col_transitions;
+    f->well_depths = c->well_depths;
+    // every empty tile below the top of its column is covered
+    f->covered_cells = (base->features & LHA_F_COVERED_CELLS) ?
+        c->aggregate_height - p->n_filled : 0;
+    f->max_height = (base->features & LHA_F_MAX_HEIGHT) ? c->max_height : 0;
+}
+
+
+/*
+ * computes the column features of the board with the piece placed, one
+ * column at a time
+ */
+static void _eval_cols_scalar(const struct eval_base *base,
+        const struct eval_piece *p, struct lha_features *f) {
+    struct eval_cols c = { 0, 0, 0, 0 };
+
+    uint8_t heights[TETRIS_WIDTH];
+
+    for (int8_t col = 0; col < TETRIS_WIDTH; col++) {
+        heights[col] = MAX(base->heights[col], p->heights[col]);
+
+        c.aggregate_height += heights[col];
+        c.max_height = MAX(c.max_height, heights[col]);
+        if (col > 0) {
+            c.bumpiness += abs(heights[col - 1] - heights[col]);
+        }
+    }
+
+    if (base->features & LHA_F_WELL_DEPTHS) {
+        for (int8_t col = 0; col < TETRIS_WIDTH; col++) {
+            uint32_t left = (col > 0) ? heights[col - 1] : WALL_HEIGHT;
+            uint32_t right = (col < TETRIS_WIDTH - 1) ? heights[col + 1] :
+                WALL_HEIGHT;
+            uint32_t rim = MIN(left, right);
+
+            c.well_depths += (rim > heights[col]) ? rim - heights[col] : 0;
+        }
+    }
+
+    _eval_finish(base, p, &c, f);
+}
+
+
+// the kernel lha_eval_batch uses at most, see lha_eval_max_kernel
+static int _max_kernel = LHA_KERNEL_AVX2;
+
+
+#if defined(__SSE2__)
+
+#define _LANES(sel) { \
+    sel(0), sel(1), sel(2), sel(3), sel(4), sel(5), sel(6), sel(7), \
+    sel(8), sel(9), sel(10), sel(11), sel(12), sel(13), sel(14), sel(15) \
+}
+
+/*
+ * selects the lanes of columns on the board
+ */
+#define _COL(col) ((col) < TETRIS_WIDTH ? 0xff : 0)
+static const uint8_t _col_lanes[N_COL_LANES] __attribute__((aligned(16))) =
+    _LANES(_COL);
+#undef _COL
+
+/*
+ * selects the lanes of the columns which have a column to their right
+ */
+#define _BUMP(col) ((col) < TETRIS_WIDTH - 1 ? 0xff : 0)
+static const uint8_t _bump_lanes[N_COL_LANES] __attribute__((aligned(16))) =
+    _LANES(_BUMP);
+#undef _BUMP
+
+/*
+ * the walls to the left of the first column and right of the last column,
+ * lined up with those columns
+ */
+#define _LWALL(col) ((col) == 0 ? WALL_HEIGHT : 0)
+static const uint8_t _left_wall[N_COL_LANES] __attribute__((aligned(16))) =
+    _LANES(_LWALL);
+#undef _LWALL
+#define _RWALL(col) ((col) == TETRIS_WIDTH - 1 ? WALL_HEIGHT : 0)
+static const uint8_t _right_wall[N_COL_LANES] __attribute__((aligned(16))) =
+    _LANES(_RWALL);
+#undef _RWALL
+
+#undef _LANES
+
+#endif
+
+
+#if defined(__SSE2__)
+
+/*
+ * the AVX2 kernel is compiled for AVX2 even when the rest of the file isn't,
+ * and is only run when the CPU supports it
+ */
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET
+static __m256i _broadcast_lanes(const uint8_t *lanes) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) lanes));
+}
+
+/*
+ * computes the column features of two pieces at once, one in each 128-bit
+ * lane
+ */
+AVX2_TARGET
+static void _eval_cols_x2(const struct eval_base *base,
+        const struct eval_piece *p0, const struct eval_piece *p1,
+        struct lha_features *f0, struct lha_features *f1) {
+    __m256i b = _broadcast_lanes(base->heights);
+    __m256i ph = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_load_si128((const __m128i *) p0->heights)),
+            _mm_load_si128((const __m128i *) p1->heights), 1);
+    __m256i zero = _mm256_setzero_si256();
+
+    __m256i h = _mm256_max_epu8(b, ph);
+
+    // column col + 1 in lane col (byte shifts stay within 128-bit lanes)
+    __m256i r = _mm256_srli_si256(h, 1);
+
+    __m256i d = _mm256_and_si256(_broadcast_lanes(_bump_lanes),
+            _mm256_or_si256(_mm256_subs_epu8(h, r), _mm256_subs_epu8(r, h)));
+
+    __m256i hs = _mm256_sad_epu8(h, zero);
+    __m256i ds = _mm256_sad_epu8(d, zero);
+
+    struct eval_cols c0 = {
+        .aggregate_height =
+            _mm256_extract_epi64(hs, 0) + _mm256_extract_epi64(hs, 1),
+        .bumpiness = _mm256_extract_epi64(ds, 0) + _mm256_extract_epi64(ds, 1),
+        .well_depths = 0,
+        .max_height = 0
+    };
+    struct eval_cols c1 = {
+        .aggregate_height =
+            _mm256_extract_epi64(hs, 2) + _mm256_extract_epi64(hs, 3),
+        .bumpiness = _mm256_extract_epi64(ds, 2) + _mm256_extract_epi64(ds, 3),
+        .well_depths = 0,
+        .max_height = 0
+    };
+
+    if (base->features & LHA_F_WELL_DEPTHS) {
+        // column col - 1 in lane col
+        __m256i l = _mm256_slli_si256(h, 1);
+
+        __m256i rim = _mm256_min_epu8(
+                _mm256_or_si256(l, _broadcast_lanes(_left_wall)),
+                _mm256_or_si256(r, _broadcast_lanes(_right_wall)));
+        __m256i w = _mm256_and_si256(_broadcast_lanes(_col_lanes),
+                _mm256_subs_epu8(rim, h));
+        __m256i ws = _mm256_sad_epu8(w, zero);
+
+        c0.well_depths =
+            _mm256_extract_epi64(ws, 0) + _mm256_extract_epi64(ws, 1);
+        c1.well_depths =
+            _mm256_extract_epi64(ws, 2) + _mm256_extract_epi64(ws, 3);
+    }
+
+    if (base->features & LHA_F_MAX_HEIGHT) {
+        __m256i m = _mm256_max_epu8(h, _mm256_srli_si256(h, 8));
+        m = _mm256_max_epu8(m, _mm256_srli_si256(m, 4));
+        m = _mm256_max_epu8(m, _mm256_srli_si256(m, 2));
+        m = _mm256_max_epu8(m, _mm256_srli_si256(m, 1));
+
+        c0.max_height = (uint8_t) _mm256_extract_epi8(m, 0);
+        c1.max_height = (uint8_t) _mm256_extract_epi8(m, 16);
+    }
+
+    _eval_finish(base, p0, &c0, f0);
+    _eval_finish(base, p1, &c1, f1);
+}
+
+#endif
+
+
+#if defined(__SSE2__)
+
+static uint32_t _sum_sad(__m128i s) {
+    return _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+}
+
+/*
+ * computes the column features of one piece, with all columns in one
+ * register
+ */
+static void _eval_cols_x1(const struct eval_base *base,
+        const struct eval_piece *p, struct lha_features *f) {
+    __m128i b = _mm_load_si128((const __m128i *) base->heights);
+    __m128i ph = _mm_load_si128((const __m128i *) p->heights);
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i h = _mm_max_epu8(b, ph);
+
+    // column col + 1 in lane col
+    __m128i r = _mm_srli_si128(h, 1);
+
+    __m128i d = _mm_and_si128(
+            _mm_load_si128((const __m128i *) _bump_lanes),
+            _mm_or_si128(_mm_subs_epu8(h, r), _mm_subs_epu8(r, h)));
+
+    struct eval_cols c = {
+        .aggregate_height = _sum_sad(_mm_sad_epu8(h, zero)),
+        .bumpiness = _sum_sad(_mm_sad_epu8(d, zero)),
+        .well_depths = 0,
+        .max_height = 0
+    };
+
+    if (base->features & LHA_F_WELL_DEPTHS) {
+        // column col - 1 in lane col
+        __m128i l = _mm_slli_si128(h, 1);
+
+        __m128i rim = _mm_min_epu8(
+                _mm_or_si128(l, _mm_load_si128((const __m128i *) _left_wall)),
+                _mm_or_si128(r,
+                    _mm_load_si128((const __m128i *) _right_wall)));
+        __m128i w = _mm_and_si128(
+                _mm_load_si128((const __m128i *) _col_lanes),
+                _mm_subs_epu8(rim, h));
+
+        c.well_depths = _sum_sad(_mm_sad_epu8(w, zero));
+    }
+
+    if (base->features & LHA_F_MAX_HEIGHT) {
+        __m128i m = _mm_max_epu8(h, _mm_srli_si128(h, 8));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+
+        c.max_height = _mm_cvtsi128_si32(m) & 0xff;
+    }
+
+    _eval_finish(base, p, &c, f);
+}
+
+#endif
+
+
+void lha_eval_features(board_t *b, piece_t piece, uint32_t features,
+        struct lha_features *f) {
+    struct eval_base base;
+    struct eval_piece p;
+
+    _eval_base(b, features, &base);
+    _eval_piece(b, piece, &base, &p);
+    _eval_cols_scalar(&base, &p, f);
+}
+
+
+void lha_eval_batch(board_t *b, const piece_t *pieces, uint32_t n,
+        uint32_t features, struct lha_features *f) {
+    struct eval_base base;
+    struct eval_piece p[LHA_EVAL_BATCH];
+
+    TETRIS_ASSERT(n <= LHA_EVAL_BATCH);
+
+    _eval_base(b, features, &base);
+    for (uint32_t i = 0; i < n; i++) {
+        _eval_piece(b, pieces[i], &base, &p[i]);
+    }
+
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    if (_max_kernel >= LHA_KERNEL_AVX2 && __builtin_cpu_supports("avx2")) {
+        for (; i + 1 < n; i += 2) {
+            _eval_cols_x2(&base, &p[i], &p[i + 1], &f[i], &f[i + 1]);
+        }
+    }
+    if (_max_kernel >= LHA_KERNEL_SSE2) {
+        for (; i < n; i++) {
+            _eval_cols_x1(&base, &p[i], &f[i]);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        _eval_cols_scalar(&base, &p[i], &f[i]);
+    }
+}
+
+
+int lha_eval_max_kernel(int kernel) {
+    _max_kernel = kernel;
+
+#if defined(__SSE2__)
+    if (kernel >= LHA_KERNEL_AVX2 && !__builtin_cpu_supports("avx2")) {
+        kernel = LHA_KERNEL_SSE2;
+    }
+    return kernel;
+#else
+    return LHA_KERNEL_SCALAR;
+#endif
+}
+
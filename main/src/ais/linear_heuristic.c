@@ -1,9 +1,14 @@
 
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <util.h>
-#include <data_structs/min_heap.h>
+#include <data_structs/radix_heap.h>
+#include <data_structs/ws_deque.h>
 
 #include <tetris.h>
 #include <tetris_state.h>
@@ -24,12 +29,27 @@
 // lowers branching factor
 #define DEFAULT_BEST_N 4
 
+// max number of frames to spend on one decision when searching within a frame
+// budget
+#define DEFAULT_MAX_THINK_FRAMES 20
+
+// log2 of the number of transposition table entries (1 MB worth)
+#define DEFAULT_TT_LOG_N_ENTRIES 16
+
+// log2 of the number of expansion cache entries (1.25 MB worth)
+#define DEFAULT_XCACHE_LOG_N_ENTRIES 14
+
 
 static const float default_cnsts[N_CNSTS] = {
     -.510066f,
      .760666f,
     -.35663f,
-    -.184483f
+    -.184483f,
+     0.f,
+     0.f,
+     0.f,
+     0.f,
+     0.f
 };
 
 
@@ -43,6 +63,12 @@ lha_t * linear_heuristic_agent_init_cnsts(const float * cnsts) {
 
     agent->depth = DEFAULT_DEPTH;
     agent->best_n = DEFAULT_BEST_N;
+    agent->max_think_frames = DEFAULT_MAX_THINK_FRAMES;
+    agent->tt_log_n_entries = DEFAULT_TT_LOG_N_ENTRIES;
+    agent->xcache_log_n_entries = DEFAULT_XCACHE_LOG_N_ENTRIES;
+
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    agent->n_threads = (n_cpus > 1) ? (int) n_cpus : 1;
 
     memcpy(agent->cnsts, cnsts, N_CNSTS * sizeof(float));
 
@@ -50,79 +76,51 @@ lha_t * linear_heuristic_agent_init_cnsts(const float * cnsts) {
 }
 
 
-void linear_heuristic_agent_destroy(lha_t *a) {
-    free(a);
-}
 
 
+/*
+ * gives the weighted sum of the features of a board
+ */
+static float _weigh(lha_t *a, const struct lha_features *f) {
+    const float * w = a->cnsts;
 
+    float h = w[0] * f->aggregate_height + w[1] * f->n_complete_lines +
+        w[2] * f->n_holes + w[3] * f->bumpiness +
+        w[4] * f->row_transitions + w[5] * f->col_transitions +
+        w[6] * f->well_depths + w[7] * f->covered_cells +
+        w[8] * f->max_height;
 
-static int _get_tile(tetris_state *s, int8_t x, int8_t y) {
-    if (board_get_tile(&s->board, x, y)) {
-        return 1;
-    }
-    return piece_contains(s->falling_piece, x, y);
+    return h;
 }
 
 
+/*
+ * gives the features of struct lha_features which have a nonzero weight, as
+ * an or of LHA_F_*'s. The rest add nothing to the heuristic, so they are not
+ * computed
+ */
+static uint32_t _weighted_features(lha_t *a) {
+    uint32_t features = 0;
 
-// goal of AI is to maximize this value
-static float heuristic(lha_t *a, tetris_state *s) {
-    uint32_t aggregate_height = 0;
-    //a hole is defined as an empty tile with the tile above it non-empty
-    uint32_t n_holes = 0;
-
-    uint32_t n_complete_lines = 0;
-
-    // cumulative sum of absolute differences in adjacent column heights
-    uint32_t bumpiness = 0;
-
-
-    // height of each column, initialize all elements to 0
-    uint8_t heights[TETRIS_WIDTH] = { 0 };
-
-
-    if (tetris_game_is_over(s)) {
-        return -INFINITY;
-    }
-
-
-    for (int8_t col = 0; col < TETRIS_WIDTH; col++) {
-        for (int8_t row = TETRIS_HEIGHT - 1; row >= 0; row--) {
-            if (_get_tile(s, col, row) && heights[col] == 0) {
-                // first tile in column that is occupied (from top to bottom)
-                // gives the height of the column
-                heights[col] = row + 1;
-            }
-        }
-    }
-
-    for (int8_t col = 0; col < TETRIS_WIDTH; col++) {
-        aggregate_height += heights[col];
-        if (col > 0) {
-            bumpiness += abs(heights[col - 1] - heights[col]);
+    for (uint32_t i = 0; i < N_CNSTS; i++) {
+        if (a->cnsts[i] != 0.f) {
+            features |= 1U << i;
         }
     }
+    return features;
+}
 
-    for (int8_t row = 0; row < TETRIS_HEIGHT; row++) {
-        int line_complete = 1;
-        for (int8_t col = 0; col < TETRIS_WIDTH; col++) {
-            n_holes += (!_get_tile(s, col, row) &&
-                         _get_tile(s, col, row + 1));
-            line_complete = line_complete && _get_tile(s, col, row);
-        }
-        n_complete_lines += line_complete;
-    }
 
-    float A = a->cnsts[0];
-    float B = a->cnsts[1];
-    float C = a->cnsts[2];
-    float D = a->cnsts[3];
+// goal of AI is to maximize this value
+static float heuristic(lha_t *a, board_t *b, const tetris_pose *pose) {
+    struct lha_features f;
 
-    float h = A * aggregate_height + B * n_complete_lines +
-        C * n_holes + D * bumpiness;
+    if (pose->state == GAME_OVER) {
+        return -INFINITY;
+    }
 
-    return h;
+    lha_eval_features(b, pose->falling_piece, _weighted_features(a), &f);
+    return _weigh(a, &f);
 }
 
 
@@ -150,31 +148,68 @@ typedef struct state_node {
      * we put the time of the state in the upper 56 bits of the key in the heap, and
      * we put the number of keystrokes made along the path in the lower 8 bits
      */
-    heap_node node;
+    radix_node node;
 
-    // snapshot of the game state at this particular state node
-    tetris_state game_state;
+    // falling piece and timing at this particular state node, everything else
+    // about the game is the same as in the state being searched from
+    tetris_pose pose;
 
-    // time at which to perform the action, must be at or before
-    // game_state.time
+    // time at which to perform the action, must be at or before pose.time
     uint64_t cb_time;
 
+    // singly linked list of possible falling spots
+    struct state_node * next;
+
     // index of state node preceeding this one on shortest path
     int32_t parent_idx;
-    // action taken to get here from parent
-    int action;
 
-    // singly linked list of possible falling spots
-    struct state_node * next;
+    // generation of the arena this node was last initialized in, if it is not
+    // the arena's current generation, then the rest of the node is stale
+    uint32_t gen;
+
+    // action taken to get here from parent
+    uint8_t action;
 } state_node;
 
 
+// number of possible states (num possible positions * num unique
+// orientations). There will be some unused space since you can't actually
+// have a piece with bottom left x-coord = width - 1, but we won't worry
+// about that for simplicity
+#define N_STATE_NODES \
+    (TETRIS_WIDTH * (TETRIS_HEIGHT + CEIL_BUFFER) * N_PIECE_ORIENTATIONS)
+
+
+/*
+ * scratch space for searching from one depth of the lookahead
+ */
+struct lha_arena {
+    // array of N_STATE_NODES state nodes, indexed by _find_idx
+    state_node * m;
+
+    // current generation of the arena, which is incremented at the start of
+    // every search so that all nodes from the previous search become stale
+    // without having to touch them
+    uint32_t gen;
+
+    // buffer of best_n_cap entries for _find_best_n
+    struct best_n_entry * best_n;
+    int best_n_cap;
+};
+
+
+struct best_n_entry {
+    state_node * node;
+    float h;
+};
+
+
 static uint64_t get_node_time(state_node * node) {
     return ((uint64_t) node->node.key) >> 8;
 }
 
 
-static state_node * __heap_node_to_state_node(heap_node * node) {
+static state_node * __heap_node_to_state_node(radix_node * node) {
     return (state_node *) (((uint64_t) node) - offsetof(state_node, node));
 }
 
@@ -187,30 +222,50 @@ static state_node * __heap_node_to_state_node(heap_node * node) {
 typedef struct state {
     state_node * m;
 
+    // generation of the nodes in m which belong to this search
+    uint32_t gen;
+
     // current time in tetris state object
     uint64_t t0;
 
-    // heap of states for dijkstra
-    heap_t h;
+    // heap of states for dijkstra, whose keys are never less than the key of
+    // the last state extracted, since every transition takes time or a
+    // keystroke
+    radix_heap_t h;
 
     // maintain singly-linked list of states which are possible landing
     // locations (if this is NULL, then it is not in the list, and we mark the
     // end of the list with LIST_END instead of NULL)
     struct state_node * falling_spots;
 
-    // pointer to game state
+    // game state being searched from, of which only the board and the tick
+    // counts are read during the search (the falling piece must not be on the
+    // board)
     tetris_state * game_state;
 } state_t;
 
 
 
+/*
+ * gives whether the falling piece of pose is low enough to have a place in the
+ * state array. Wall kicks can lift a piece which spawned above a nearly full
+ * board out of it
+ */
+static int _in_state_array(const tetris_pose * pose) {
+    int8_t x, y;
+
+    piece_bottom_left_corner(pose->falling_piece, &x, &y);
+    return y < TETRIS_HEIGHT + CEIL_BUFFER;
+}
+
+
 /*
  * gives index in state array where the state with falling piece = p is
  */
-static uint32_t _find_idx(tetris_state * game_state) {
+static uint32_t _find_idx(const tetris_pose * pose) {
     int8_t x, y;
 
-    piece_t p = game_state->falling_piece;
+    piece_t p = pose->falling_piece;
 
     // find bottom left corner of piece, which must be in bounds of the the
     // board
@@ -229,23 +284,38 @@ static uint32_t _find_idx(tetris_state * game_state) {
  * gives a pointer to the state node struct in the state array, given the
  * falling piece's location
  */
-static state_node * __find_state_node(state_t * s, tetris_state * game_state) {
-    uint32_t idx = _find_idx(game_state);
-    return &s->m[idx];
+static state_node * __find_state_node(state_t * s, const tetris_pose * pose) {
+    uint32_t idx = _find_idx(pose);
+    state_node * node = &s->m[idx];
+
+    if (node->gen != s->gen) {
+        // first time this node is touched in this search, so it starts
+        // infinitely far away and not in the list of falling spots
+        RADIX_NODE_SET(&node->node, INFTY);
+        node->next = NULL;
+        node->gen = s->gen;
+    }
+
+    return node;
 }
 
 
 
 /*
- * discover new path to new_state, where action is performed at time "cb_time"
+ * discover new path to new_pose, where action is performed at time "cb_time"
  * and the preceding state is parent_idx
  */
-static void __try_decrease(state_t * s, tetris_state * new_state,
+static void __try_decrease(state_t * s, const tetris_pose * new_pose,
         uint64_t cb_time, uint32_t parent_idx, int action) {
 
-    uint64_t new_time = new_state->time;
+    uint64_t new_time = new_pose->time;
+
+    if (!_in_state_array(new_pose)) {
+        // leave such poses out of the search
+        return;
+    }
 
-    state_node * node = __find_state_node(s, new_state);
+    state_node * node = __find_state_node(s, new_pose);
 
     // we will be using lower 8 bits of key to store number of keystrokes
     TETRIS_ASSERT(new_time < 0x0080000000000000);
@@ -268,18 +338,18 @@ static void __try_decrease(state_t * s, tetris_state * new_state,
     uint64_t key_val = (new_time << 8) | parent_key_strokes;
 
     if (node->node.key == INFTY) {
-        HEAP_NODE_SET(&node->node, key_val);
-        heap_insert(&s->h, &node->node);
+        RADIX_NODE_SET(&node->node, key_val);
+        radix_heap_insert(&s->h, &node->node);
     }
     else if (node->node.key > key_val) {
-        heap_decrease_key(&s->h, &node->node, key_val);
+        radix_heap_decrease_key(&s->h, &node->node, key_val);
     }
     else {
         return;
     }
 
     // if the node was decreased, update its fields
-    tetris_state_shallow_copy(&node->game_state, new_state);
+    node->pose = *new_pose;
     node->cb_time = cb_time;
     node->parent_idx = parent_idx;
     node->action = action;
@@ -305,20 +375,22 @@ static void __try_falling_spot_append(state_t * s, state_node * node) {
  */
 static void _run_dijkstra(state_t *s) {
     state_node * node;
-    tetris_state * game_state, new_state;
+    tetris_pose * pose, new_pose;
     uint64_t time = 0;
 
-    while ((node = __heap_node_to_state_node(heap_extract_min(&s->h))) !=
-            NULL) {
-        game_state = &node->game_state;
-        //print_board(game_state);
+    // the board and tick counts all transitions are made against
+    tetris_state * ctx = s->game_state;
+
+    while ((node = __heap_node_to_state_node(
+                    radix_heap_extract_min(&s->h))) != NULL) {
+        pose = &node->pose;
 
         // discovered nodes must be non-decreasing in time
-        TETRIS_ASSERT(node->game_state.time >= time);
+        TETRIS_ASSERT(pose->time >= time);
 
-        time = game_state->time;
+        time = pose->time;
         //printf("Extracted %p %d (%f)\n", node, fp.piece_idx, (time - s->t0) / 60.f);
-        uint32_t parent_idx = _find_idx(game_state);
+        uint32_t parent_idx = _find_idx(pose);
 
         // find all possible successors of this node
 
@@ -326,97 +398,98 @@ static void _run_dijkstra(state_t *s) {
 
         // translations:
         // press left
-        tetris_state_shallow_copy(&new_state, game_state);
-        if (tetris_move_piece_transient(&new_state, -1, 0)) {
+        new_pose = *pose;
+        if (tetris_pose_move(ctx, &new_pose, -1, 0)) {
             // advance game by input delay ticks
             uint64_t adv = AI_INPUT_DELAY;
-            if (tetris_advance_by_transient(&new_state, &adv) == 0) {
+            if (tetris_pose_advance_by(ctx, &new_pose, &adv) == 0) {
                 // only add to the list of reachable states if the move is
                 // possible
-                __try_decrease(s, &new_state, time, parent_idx, GO_LEFT);
+                __try_decrease(s, &new_pose, time, parent_idx, GO_LEFT);
             }
         }
 
         // press right
-        tetris_state_shallow_copy(&new_state, game_state);
-        if (tetris_move_piece_transient(&new_state, 1, 0)) {
+        new_pose = *pose;
+        if (tetris_pose_move(ctx, &new_pose, 1, 0)) {
             // advance game by input delay ticks
             uint64_t adv = AI_INPUT_DELAY;
-            if (tetris_advance_by_transient(&new_state, &adv) == 0) {
+            if (tetris_pose_advance_by(ctx, &new_pose, &adv) == 0) {
                 // only add to the list of reachable states if the move is
                 // possible
-                __try_decrease(s, &new_state, time, parent_idx, GO_RIGHT);
+                __try_decrease(s, &new_pose, time, parent_idx, GO_RIGHT);
             }
         }
 
         // press down
-        tetris_state_shallow_copy(&new_state, game_state);
+        new_pose = *pose;
         // can only move down on minor time steps
-        if ((tetris_is_minor_time_step(&new_state) &&
-                    !tetris_is_major_time_step(&new_state)) ||
-                tetris_advance_to_next_minor_time_step(&new_state) == 0) {
+        if ((tetris_pose_is_minor_time_step(ctx, &new_pose) &&
+                    !tetris_pose_is_major_time_step(ctx, &new_pose)) ||
+                tetris_pose_advance_to_next_minor_time_step(ctx,
+                    &new_pose) == 0) {
 
-            if (tetris_move_piece_transient(&new_state, 0, -1)) {
+            if (tetris_pose_move(ctx, &new_pose, 0, -1)) {
 
-                uint64_t down_time = new_state.time;
+                uint64_t down_time = new_pose.time;
 
                 // advance game by input delay ticks
                 uint64_t adv = AI_INPUT_DELAY;
-                if (tetris_advance_by_transient(&new_state, &adv) != 0) {
+                if (tetris_pose_advance_by(ctx, &new_pose, &adv) != 0) {
                     // could not advance because either the game ended or 
                 }
                 else {
-                    //TETRIS_ASSERT(piece_equals(cur_piece, new_state.falling_piece));
+                    //TETRIS_ASSERT(piece_equals(cur_piece, new_pose.falling_piece));
                     // only allow pressing down if gravity will not be moving
                     // the falling piece down
-                    __try_decrease(s, &new_state, down_time, parent_idx,
+                    __try_decrease(s, &new_pose, down_time, parent_idx,
                             GO_DOWN);
                 }
             }
         }
 
         // press rotate clockwise
-        tetris_state_shallow_copy(&new_state, game_state);
-        if (tetris_rotate_piece_transient(&new_state, ROTATE_CLOCKWISE, 1)) {
+        new_pose = *pose;
+        if (tetris_pose_rotate(ctx, &new_pose, ROTATE_CLOCKWISE, 1)) {
             // advance game by input delay ticks
             uint64_t adv = AI_INPUT_DELAY;
-            if (tetris_advance_by_transient(&new_state, &adv) != 0) {
+            if (tetris_pose_advance_by(ctx, &new_pose, &adv) != 0) {
                 // could not advance because either the game ended or 
             }
             else {
-                __try_decrease(s, &new_state, time, parent_idx, ROTATE_C);
+                __try_decrease(s, &new_pose, time, parent_idx, ROTATE_C);
             }
         }
 
         // press rotate counterclockwise
-        tetris_state_shallow_copy(&new_state, game_state);
-        if (tetris_rotate_piece_transient(&new_state,
+        new_pose = *pose;
+        if (tetris_pose_rotate(ctx, &new_pose,
                     ROTATE_COUNTERCLOCKWISE, 1)) {
             // advance game by input delay ticks
             uint64_t adv = AI_INPUT_DELAY;
-            if (tetris_advance_by_transient(&new_state, &adv) != 0) {
+            if (tetris_pose_advance_by(ctx, &new_pose, &adv) != 0) {
                 // could not advance because either the game ended or 
             }
             else {
-                __try_decrease(s, &new_state, time, parent_idx, ROTATE_CC);
+                __try_decrease(s, &new_pose, time, parent_idx, ROTATE_CC);
             }
         }
 
         // wait for it to fall
-        tetris_state_shallow_copy(&new_state, game_state);
+        new_pose = *pose;
         // advance game until the piece drops
-        int ret = tetris_advance_until_drop_transient(&new_state);
+        int ret = tetris_pose_advance_until_drop(ctx, &new_pose);
         if (ret == 1) {
             // this piece can stick
-            state_node * falling_spot = __find_state_node(s, &new_state);
+            state_node * falling_spot = __find_state_node(s, &new_pose);
             __try_falling_spot_append(s, falling_spot);
         }
         else {
             // if the piece did not stick, it must have moved
-            TETRIS_ASSERT(!piece_equals(game_state->falling_piece,
-                        new_state.falling_piece));
-            // wait until the gravity would drop the piece (new_state.time)
-            __try_decrease(s, &new_state, new_state.time, parent_idx, WAIT);
+            TETRIS_ASSERT(!piece_equals(pose->falling_piece,
+                        new_pose.falling_piece));
+            // wait until the gravity would drop the piece (new_pose.time)
+            __try_decrease(s, &new_pose, new_pose.time, parent_idx, WAIT);
         }
 
     }
@@ -440,7 +513,7 @@ state_node * _construct_path_to(state_t *s, state_node *node) {
     int prev_action = WAIT;
     // wait until the final state of the game, which is wherever the game state
     // ends after performing the action
-    uint64_t prev_cb_time = node->game_state.time;
+    uint64_t prev_cb_time = node->pose.time;
 
     while (1) {
         node->next = prev;
@@ -471,31 +544,119 @@ static int _at_top_level(lha_t *a, int depth) {
 }
 
 
-static float _find_best_path(lha_t *a, tetris_state *s, int depth);
+static float _find_best_path(lha_t *a, struct lha_scratch *sc, tetris_state *s,
+        int depth);
 
 
 
 /*
- * make a deep copy of the board and recursively call find best path
+ * gives a key for the position of the game in s, which covers the board, the
+ * falling and held pieces, the rest of the piece queue, and whether the game
+ * is over, but not the timing of the game
  */
-static float _depth_find(lha_t *a, state_t *s, state_node *fs, int depth) {
-    tetris_state tmp;
+static uint64_t _position_key(tetris_state *s) {
+    uint64_t queue[2] = { 0, 0 };
+    __builtin_memcpy(queue, s->piece_queue, sizeof(s->piece_queue));
+
+    uint64_t key = tetris_state_hash(s);
+    key = tetris_hash_mix(key ^ queue[0]);
+    key = tetris_hash_mix(key ^ queue[1]);
+    key = tetris_hash_mix(key ^ s->state);
+
+    // 0 is the key of an empty slot in the tables keyed by this
+    return (key == 0) ? 1 : key;
+}
+
+
+/*
+ * gives the transposition table key of the lookahead of the given depth from
+ * s, which covers everything the search from s depends on: the position and
+ * the timing of the game
+ */
+static uint64_t _tt_key(tetris_state *s, int depth) {
+    uint32_t tick_time = (uint32_t) s->major_tick_time;
+    uint32_t tick_count = s->major_tick_count;
+    uint32_t fp_data;
+    __builtin_memcpy(&fp_data, &s->fp_data, sizeof(fp_data));
+
+    uint64_t key = _position_key(s);
+    key = tetris_hash_mix(key ^
+            (((uint64_t) tick_count) << 32 | tick_time));
+    key = tetris_hash_mix(key ^ (((uint64_t) fp_data) << 8 | (uint8_t) depth));
+
+    return (key == 0) ? 1 : key;
+}
+
+
+/*
+ * looks up the heuristic value of key in a's transposition table, writing it
+ * to *h if found
+ *
+ * returns 1 if found, 0 if not
+ */
+static int _tt_lookup(lha_t *a, uint64_t key, float *h) {
+    uint64_t val;
+
+    if (a->__tt == NULL || !trans_table_lookup(a->__tt, key, &val)) {
+        return 0;
+    }
+
+    uint32_t bits = (uint32_t) val;
+    __builtin_memcpy(h, &bits, sizeof(*h));
+    return 1;
+}
+
+
+static void _tt_store(lha_t *a, uint64_t key, float h) {
+    uint32_t bits;
+
+    if (a->__tt != NULL) {
+        __builtin_memcpy(&bits, &h, sizeof(bits));
+        trans_table_store(a->__tt, key, bits);
+    }
+}
+
 
-    // make deep copy of the game state at state_node fs
-    tetris_state_deep_copy(&tmp, &fs->game_state);
+/*
+ * makes dst the game state after the falling piece of src lands at pose, and
+ * the next falling piece is fetched
+ */
+static void _make_child_state(tetris_state *dst, tetris_state *src,
+        const tetris_pose *pose) {
+    // make deep copy of the game state at pose
+    tetris_state_deep_copy(dst, src);
+    tetris_pose_set(dst, pose);
+    dst->flags |= LOOKAHEAD_STATE;
 
     // save the current falling piece, since it will be changed
-    piece_t old_fp = tmp.falling_piece;
+    piece_t old_fp = dst->falling_piece;
 
     // put the falling piece on the board
-    board_place_piece(&tmp.board, old_fp);
+    board_place_piece(&dst->board, old_fp);
     // clear any lines cleared by this piece
-    tetris_clear_lines(&tmp);
+    tetris_clear_lines(dst);
     // fetch the next falling piece
-    tetris_get_next_falling_piece_transient(&tmp);
+    tetris_get_next_falling_piece_transient(dst);
+}
+
+
+/*
+ * make a deep copy of the board and recursively call find best path, unless
+ * the transposition table already has the result
+ */
+static float _depth_find(lha_t *a, struct lha_scratch *sc, state_t *s,
+        state_node *fs, int depth) {
+    tetris_state tmp;
 
-    // recursively call find best path on the new state
-    float h = _find_best_path(a, &tmp, depth - 1);
+    _make_child_state(&tmp, s->game_state, &fs->pose);
+
+    float h;
+    uint64_t key = _tt_key(&tmp, depth - 1);
+    if (!_tt_lookup(a, key, &h)) {
+        // recursively call find best path on the new state
+        h = _find_best_path(a, sc, &tmp, depth - 1);
+        _tt_store(a, key, h);
+    }
 
     tetris_state_destroy(&tmp);
 
@@ -503,40 +664,103 @@ static float _depth_find(lha_t *a, state_t *s, state_node *fs, int depth) {
 }
 
 
-static state_node * _find_best_n(lha_t *a, state_node * falling_spots, int n) {
-    struct sh {
-        state_node * node;
-        float h;
-    } * best_n;
+/*
+ * computes the heuristic of each of the landing spots nodes[0..n) on b at
+ * once, writing them to h[0..n). n may be at most LHA_EVAL_BATCH
+ */
+static void _heuristic_batch(lha_t *a, board_t *b, state_node **nodes,
+        uint32_t n, float *h) {
+    piece_t pieces[LHA_EVAL_BATCH];
+    struct lha_features f[LHA_EVAL_BATCH];
+
+    for (uint32_t i = 0; i < n; i++) {
+        pieces[i] = nodes[i]->pose.falling_piece;
+    }
+    lha_eval_batch(b, pieces, n, _weighted_features(a), f);
+
+    for (uint32_t i = 0; i < n; i++) {
+        h[i] = (nodes[i]->pose.state == GAME_OVER) ? -INFINITY :
+            _weigh(a, &f[i]);
+    }
+}
 
-    best_n = (struct sh *) calloc(n, sizeof(struct sh));
 
-    for (state_node * fs = falling_spots; fs != LIST_END; fs = fs->next) {
-        float h = heuristic(a, &fs->game_state);
+/*
+ * gathers up to LHA_EVAL_BATCH nodes of the list starting at *list into
+ * nodes, advancing *list past them
+ *
+ * returns the number of nodes gathered
+ */
+static uint32_t _next_batch(state_node **list, state_node **nodes) {
+    uint32_t n = 0;
+    for (state_node * fs = *list; fs != LIST_END && n < LHA_EVAL_BATCH;
+            fs = fs->next) {
+        nodes[n++] = fs;
+    }
+    if (n > 0) {
+        *list = nodes[n - 1]->next;
+    }
+    return n;
+}
 
-        for (uint32_t i = 0; i < n; i++) {
-            struct sh * tmp = &best_n[i];
 
-            if (tmp->node == NULL) {
-                // take the spot
-                tmp->node = fs;
-                tmp->h = h;
-                break;
-            }
-            else if (tmp->h < h) {
-                // supercede this spot
-                state_node * swp = fs;
-                do {
-                    struct sh old = best_n[i];
-
-                    best_n[i].node = swp;
-                    best_n[i].h = h;
-
-                    swp = old.node;
-                    h = old.h;
-                    i++;
-                } while (i < n && swp != NULL);
-            }
+/*
+ * inserts fs with heuristic value h into the list best_n of the n best landing
+ * spots seen so far, sorted from best to worst
+ */
+static void _best_n_insert(struct best_n_entry *best_n, int n,
+        state_node *fs, float h) {
+    for (uint32_t i = 0; i < n; i++) {
+        struct best_n_entry * tmp = &best_n[i];
+
+        if (tmp->node == NULL) {
+            // take the spot
+            tmp->node = fs;
+            tmp->h = h;
+            break;
+        }
+        else if (tmp->h < h) {
+            // supercede this spot
+            state_node * swp = fs;
+            do {
+                struct best_n_entry old = best_n[i];
+
+                best_n[i].node = swp;
+                best_n[i].h = h;
+
+                swp = old.node;
+                h = old.h;
+                i++;
+            } while (i < n && swp != NULL);
+        }
+    }
+}
+
+
+static state_node * _find_best_n(lha_t *a, struct lha_arena *arena,
+        state_t *s, int n) {
+    struct best_n_entry * best_n;
+
+    if (arena->best_n_cap < n) {
+        free(arena->best_n);
+        arena->best_n = (struct best_n_entry *)
+            malloc(n * sizeof(struct best_n_entry));
+        arena->best_n_cap = n;
+    }
+    best_n = arena->best_n;
+    memset(best_n, 0, n * sizeof(struct best_n_entry));
+
+    // evaluate the landing spots a batch at a time
+    state_node * nodes[LHA_EVAL_BATCH];
+    float hs[LHA_EVAL_BATCH];
+    uint32_t n_batch;
+
+    state_node * list = s->falling_spots;
+    while ((n_batch = _next_batch(&list, nodes)) > 0) {
+        _heuristic_batch(a, &s->game_state->board, nodes, n_batch, hs);
+
+        for (uint32_t i = 0; i < n_batch; i++) {
+            _best_n_insert(best_n, n, nodes[i], hs[i]);
         }
     }
 
@@ -547,77 +771,112 @@ static state_node * _find_best_n(lha_t *a, state_node * falling_spots, int n) {
     }
     best_n[i].node->next = LIST_END;
 
-    state_node * ret = best_n[0].node;
+    return best_n[0].node;
+}
 
-    free(best_n);
 
-    return ret;
+/*
+ * gives the list of landing spots of s which are worth looking further into
+ */
+static state_node * _candidates(lha_t *a, struct lha_arena *arena,
+        state_t *s) {
+    if (a->best_n == -1) {
+        return s->falling_spots;
+    }
+    // find best n places to land
+    return _find_best_n(a, arena, s, a->best_n);
 }
 
 
 /*
- * go through list of possible landing spots and choose which one makes
- * heuristic highest
+ * goes through the list of candidate landing spots in order, and finds the one
+ * which makes the heuristic highest, writing it to *best (ties go to the one
+ * that comes first)
  *
- * returns the heuristic value of the best landing spot
+ * returns the heuristic value of that landing spot
  */
-static float _choose_best_dst(lha_t *a, state_t *s, int depth) {
+static float _best_of(lha_t *a, struct lha_scratch *sc, state_t *s,
+        state_node *cands, int depth, state_node **best) {
 
-    state_node * best = NULL;
     float max_h = -INFINITY;
 
-    if (a->best_n == -1) {
+    *best = NULL;
+    if (depth == 1) {
+        // evaluate the landing spots a batch at a time
+        state_node * nodes[LHA_EVAL_BATCH];
+        float hs[LHA_EVAL_BATCH];
+        uint32_t n_batch;
+
+        state_node * list = cands;
+        while ((n_batch = _next_batch(&list, nodes)) > 0) {
+            _heuristic_batch(a, &s->game_state->board, nodes, n_batch, hs);
+
+            for (uint32_t i = 0; i < n_batch; i++) {
+                if (hs[i] > max_h) {
+                    max_h = hs[i];
+                    *best = nodes[i];
+                }
+            }
+        }
+
+        return max_h;
+    }
 
-        for (state_node * fs = s->falling_spots; fs != LIST_END; fs = fs->next) {
+    for (state_node * fs = cands; fs != LIST_END; fs = fs->next) {
 
-            float h;
-            if (depth == 1) {
-                h = heuristic(a, &fs->game_state);
-            }
-            else {
-                h = _depth_find(a, s, fs, depth);
-            }
+        float h = _depth_find(a, sc, s, fs, depth);
 
-            /*if (_at_top_level(a, depth)) {
-                printf("%f\n", h);
-                print_board(&fs->game_state);
-            }*/
+        /*if (_at_top_level(a, depth)) {
+            printf("%f\n", h);
+            print_piece(fs->pose.falling_piece);
+        }*/
 
-            if (h > max_h) {
-                max_h = h;
-                best = fs;
-            }
+        if (h > max_h) {
+            max_h = h;
+            *best = fs;
         }
     }
-    else {
-        // find best n places to land
-        state_node * best_n = _find_best_n(a, s->falling_spots, a->best_n);
 
-        for (state_node * fs = best_n; fs != LIST_END; fs = fs->next) {
+    return max_h;
+}
+
 
-            float h;
-            if (depth == 1) {
-                h = heuristic(a, &fs->game_state);
-            }
-            else {
-                h = _depth_find(a, s, fs, depth);
-            }
+static int _par_best_of(lha_t *a, state_t *s, state_node *cands, int depth,
+        state_node **best, float *max_h);
 
-            /*if (_at_top_level(a, depth)) {
-                printf("%f\n", h);
-                print_board(&fs->game_state);
-            }*/
+static float _beam_best_of(lha_t *a, struct lha_scratch *sc, state_t *s,
+        int depth, state_node **best);
 
-            if (h > max_h) {
-                max_h = h;
-                best = fs;
-            }
+static void _ponder_post(lha_t *a, state_t *s, state_node *best);
 
-        }
 
+/*
+ * go through list of candidate landing spots and choose which one makes
+ * heuristic highest
+ *
+ * returns the heuristic value of the best landing spot
+ */
+static float _choose_best_dst(lha_t *a, struct lha_scratch *sc, state_t *s,
+        state_node *cands, int depth) {
+
+    state_node * best;
+    float max_h;
+
+    if (_at_top_level(a, depth) && a->beam_width > 0) {
+        max_h = _beam_best_of(a, sc, s, depth, &best);
+    }
+    // the lookahead from the top level is split up between threads, every
+    // deeper level is searched by whichever thread gets to it
+    else if (!_at_top_level(a, depth) || depth == 1 || a->n_threads <= 1 ||
+            _par_best_of(a, s, cands, depth, &best, &max_h) != 0) {
+        max_h = _best_of(a, sc, s, cands, depth, &best);
     }
 
     if (_at_top_level(a, depth) && best != NULL) {
+        if (a->beam_width == 0) {
+            _ponder_post(a, s, best);
+        }
+
         state_node * path = _construct_path_to(s, best);
         a->__int_state.action_list = path;
     
@@ -644,7 +903,7 @@ static float _choose_best_dst(lha_t *a, state_t *s, int depth) {
                     printf("wait\n");
                     break;
             }
-            print_board(&fs->game_state);
+            print_piece(fs->pose.falling_piece);
             printf("\n");
         }*/
     }
@@ -654,100 +913,1794 @@ static float _choose_best_dst(lha_t *a, state_t *s, int depth) {
 
 
 
-// calculate all places we can go and construct a path to the place with
-// highest heuristic score
-//
-// if a is NULL, then only return the best heuristic value, don't construct
-// a path
-static float _find_best_path(lha_t *a, tetris_state *s, int depth) {
-    state_t state;
+static void _arena_destroy(struct lha_arena *arena) {
+    free(arena->m);
+    free(arena->best_n);
+}
 
-    // initial time
-    state.t0 = s->time;
 
-    heap_init(&state.h);
+static void _scratch_destroy(struct lha_scratch *sc) {
+    for (int i = 0; i < sc->n_arenas; i++) {
+        _arena_destroy(&sc->arenas[i]);
+    }
+    free(sc->arenas);
+}
+
 
-    state.game_state = s;
+static void _pool_destroy(struct lha_pool *pool);
+static void _beam_destroy(struct lha_beam *beam);
+static void _xcache_destroy(struct lha_xcache *xc);
+static void _xcache_clear(struct lha_xcache *xc);
+static void _decision_destroy(struct lha_decision *dec);
+static void _ponder_destroy(struct lha_ponder *p);
+static void _ponder_quiesce(struct lha_ponder *p);
 
-    // list of falling spots starts off empty
-    state.falling_spots = LIST_END;
 
-    // number of possible states (num possible positions * num unique
-    // orientations). There will be some unused space since you can't actually
-    // have a piece with bottom left x-coord = width - 1, but we won't worry
-    // about that for simplicity
-    uint64_t board_size = TETRIS_WIDTH * (TETRIS_HEIGHT + CEIL_BUFFER)
-        * N_PIECE_ORIENTATIONS;
+void linear_heuristic_agent_destroy(lha_t *a) {
+    // the pondering thread searches with everything below, so it has to be
+    // stopped first
+    if (a->__ponder != NULL) {
+        _ponder_destroy(a->__ponder);
+    }
+    if (a->__pool != NULL) {
+        _pool_destroy(a->__pool);
+    }
+    if (a->__tt != NULL) {
+        trans_table_destroy(a->__tt);
+        free(a->__tt);
+    }
+    if (a->__beam != NULL) {
+        _beam_destroy(a->__beam);
+    }
+    if (a->__xcache != NULL) {
+        _xcache_destroy(a->__xcache);
+    }
+    if (a->__decision != NULL) {
+        _decision_destroy(a->__decision);
+    }
+    _scratch_destroy(&a->__scratch);
+    free(a);
+}
 
-    state.m = (state_node *) calloc(board_size, sizeof(state_node));
 
-    for (uint32_t idx = 0; idx < board_size; idx++) {
-        // each node starts infinitely far away
-        HEAP_NODE_SET(&state.m[idx].node, INFTY);
+void linear_heuristic_agent_clear_tt(lha_t *a) {
+    // the pondering thread may be probing the tables
+    if (a->__ponder != NULL) {
+        _ponder_quiesce(a->__ponder);
+    }
+    if (a->__tt != NULL) {
+        trans_table_clear(a->__tt);
     }
+    if (a->__xcache != NULL) {
+        _xcache_clear(a->__xcache);
+    }
+}
 
 
-    // and add its node to the heap
-    state_node * fp_node = __find_state_node(&state, s);
+void linear_heuristic_agent_tt_stats(lha_t *a, trans_table_stats *stats) {
+    if (a->__tt != NULL) {
+        trans_table_get_stats(a->__tt, stats);
+    }
+    else {
+        memset(stats, 0, sizeof(trans_table_stats));
+    }
+}
 
-    // we will be using lower 8 bits of key to store number of keystrokes
-    TETRIS_ASSERT(state.t0 < 0x0080000000000000);
-    HEAP_NODE_SET(&fp_node->node, state.t0 << 8);
 
-    // copy the game state into the first node
-    tetris_state_shallow_copy(&fp_node->game_state, s);
+/*
+ * makes the transposition table if this is the first time the agent is run
+ */
+static void _init_tt(lha_t *a) {
+    if (a->__tt != NULL || a->tt_log_n_entries == 0) {
+        return;
+    }
+
+    trans_table_t * tt = (trans_table_t *) malloc(sizeof(trans_table_t));
+    TETRIS_ASSERT(tt != NULL);
+    if (trans_table_init(tt, a->tt_log_n_entries) != 0) {
+        TETRIS_ASSERT(0);
+    }
+    a->__tt = tt;
+}
 
-    // starting node has no parent, so make parent index -1 (invalid)
-    fp_node->parent_idx = -1;
-    heap_insert(&state.h, &fp_node->node);
 
-    // calculate paths to all locations on the board and find a list of
-    // possible landing locaations
-    _run_dijkstra(&state);
+/*
+ * gives the arena to search from at the given depth, allocating it if this is
+ * the first search at this depth
+ */
+static struct lha_arena * _get_arena(struct lha_scratch *sc, int depth) {
+    if (depth > sc->n_arenas) {
+        struct lha_arena * arenas = (struct lha_arena *)
+            realloc(sc->arenas, depth * sizeof(struct lha_arena));
+        TETRIS_ASSERT(arenas != NULL);
+
+        memset(&arenas[sc->n_arenas], 0,
+                (depth - sc->n_arenas) * sizeof(struct lha_arena));
+        sc->arenas = arenas;
+        sc->n_arenas = depth;
+    }
 
-    heap_destroy(&state.h);
+    struct lha_arena * arena = &sc->arenas[depth - 1];
+    if (arena->m == NULL) {
+        // all nodes start at generation 0, which is never a current generation
+        arena->m = (state_node *) calloc(N_STATE_NODES, sizeof(state_node));
+        TETRIS_ASSERT(arena->m != NULL);
+    }
+    return arena;
+}
 
-    // choose the best place to land of those landing spots, based
-    // on heuristic
-    float ret = _choose_best_dst(a, &state, depth);
 
-    if (_at_top_level(a, depth)) {
-        // will be freed once the list is no longer in use
-        a->__int_state.to_free = state.m;
+/*
+ * starts a new generation of the arena, invalidating all of its nodes
+ */
+static uint32_t _arena_next_gen(struct lha_arena *arena) {
+    arena->gen++;
+
+    if (arena->gen == 0) {
+        // the generation counter wrapped around, so nodes from 2^32
+        // generations ago could be mistaken for current ones
+        for (uint32_t idx = 0; idx < N_STATE_NODES; idx++) {
+            arena->m[idx].gen = 0;
+        }
+        arena->gen = 1;
     }
-    else {
-        free(state.m);
+    return arena->gen;
+}
+
+
+
+/*
+ * finds every place the falling piece of s->game_state can lock without
+ * regard to timing, making a falling spot for each. None of the nodes have
+ * paths to them, so this can't be used to move the piece
+ */
+static void _find_placements(state_t *s) {
+    piece_t placements[BOARD_MAX_PLACEMENTS];
+    tetris_state * gs = s->game_state;
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, gs);
+
+    uint32_t n = board_piece_placements(&gs->board, pose.falling_piece,
+            placements);
+
+    if (n == 0) {
+        // the piece doesn't fit where it starts, so the game is over
+        pose.state = GAME_OVER;
+        state_node * node = __find_state_node(s, &pose);
+        node->pose = pose;
+        __try_falling_spot_append(s, node);
+        return;
     }
 
-    return ret;
+    // falling spots are prepended, so go backwards to keep them in order
+    for (uint32_t i = n; i > 0; i--) {
+        pose.falling_piece = placements[i - 1];
+
+        // the game ends if the piece locks entirely above the board
+        pose.state = board_can_place_piece(&gs->board, pose.falling_piece) ?
+            gs->state : GAME_OVER;
+
+        state_node * node = __find_state_node(s, &pose);
+        node->pose = pose;
+        node->parent_idx = -1;
+        __try_falling_spot_append(s, node);
+    }
 }
 
 
 /*
- * try to perform an action, doing so if the next action in the queue is ready,
- * otherwise wait
+ * starts a search from s in the arena of sc for the given depth, which has no
+ * falling spots yet
  *
- * return 1 if the action could be performed, 0 if we are waiting
+ * returns the arena
  */
-int _try_move(state_node * action, tetris_state *s) {
+static struct lha_arena * _search_init(struct lha_scratch *sc,
+        tetris_state *s, int depth, state_t *state) {
 
-    if (s->state == PLAY && action->cb_time <= s->time) {
-        // time to perform the action
-        int ret = 1;
+    // initial time
+    state->t0 = s->time;
 
-        if (!tetris_state_is_transient(s)) {
-            tetris_remove_falling_piece(s);
-        }
-        switch (action->action) {
-            case GO_LEFT:
-                tetris_move_piece_transient(s, -1, 0);
-                break;
-            case GO_RIGHT:
-                tetris_move_piece_transient(s, 1, 0);
-                break;
-            case GO_DOWN:
-                tetris_move_piece_transient(s, 0, -1);
-                break;
+    state->game_state = s;
+
+    // list of falling spots starts off empty
+    state->falling_spots = LIST_END;
+
+    // nodes left over from the last search at this depth are all made stale,
+    // and are reinitialized as they are reached
+    struct lha_arena * arena = _get_arena(sc, depth);
+    state->m = arena->m;
+    state->gen = _arena_next_gen(arena);
+
+    return arena;
+}
+
+
+/*
+ * calculate all places we can go from s, searching in the arena of sc for the
+ * given depth. Only the top level needs paths that can be followed, so below
+ * it only the places the piece can lock are found, unless a->timed_lookahead
+ * is set
+ *
+ * returns the arena, which the nodes of state point into
+ */
+static struct lha_arena * _search(lha_t *a, struct lha_scratch *sc,
+        tetris_state *s, int depth, state_t *state) {
+
+    struct lha_arena * arena = _search_init(sc, s, depth, state);
+
+    if (!_at_top_level(a, depth) && !a->timed_lookahead) {
+        _find_placements(state);
+        return arena;
+    }
+
+    radix_heap_init(&state->h);
+
+    // and add its node to the heap
+    tetris_pose fp_pose;
+    tetris_pose_get(&fp_pose, s);
+    state_node * fp_node = __find_state_node(state, &fp_pose);
+
+    // we will be using lower 8 bits of key to store number of keystrokes
+    TETRIS_ASSERT(state->t0 < 0x0080000000000000);
+    RADIX_NODE_SET(&fp_node->node, state->t0 << 8);
+
+    // copy the falling piece and timing into the first node
+    fp_node->pose = fp_pose;
+
+    // starting node has no parent, so make parent index -1 (invalid)
+    fp_node->parent_idx = -1;
+    radix_heap_insert(&state->h, &fp_node->node);
+
+    // calculate paths to all locations on the board and find a list of
+    // possible landing locaations
+    _run_dijkstra(state);
+
+    radix_heap_destroy(&state->h);
+
+    return arena;
+}
+
+
+/*
+ * expansion cache
+ *
+ * below the top level, the candidate landing spots of a game state depend
+ * only on its position, not on the timing or how deep in the lookahead it
+ * is. Each search goes one piece deeper than the one before, so almost every
+ * game state it looks at was already expanded by the last search, one ply
+ * further down. These are kept in a fixed-size, direct-mapped table, so that
+ * only game states with the newly revealed piece in the queue need to be
+ * searched again
+ *
+ * entries are written with a sequence lock, and readers which see an entry
+ * being written treat it as a miss, so no thread ever waits on another
+ */
+
+// max number of candidates an entry can hold, game states with more than this
+// (i.e. when best_n is larger or -1) are not cached
+#define XCACHE_MAX_CANDS 8
+
+
+struct xcache_entry {
+    // odd while the entry is being written
+    atomic_uint seq;
+
+    _Atomic uint64_t key;
+    atomic_uint n_cands;
+
+    // each candidate landing spot, in order, with its piece in the low 32
+    // bits and its heuristic value in the high 32 bits
+    _Atomic uint64_t cands[XCACHE_MAX_CANDS];
+};
+
+
+struct lha_xcache {
+    // number of entries - 1, where the number of entries is a power of 2
+    uint64_t mask;
+    struct xcache_entry * entries;
+};
+
+
+static void _init_xcache(lha_t *a) {
+    if (a->__xcache != NULL || a->xcache_log_n_entries == 0) {
+        return;
+    }
+
+    struct lha_xcache * xc = (struct lha_xcache *)
+        malloc(sizeof(struct lha_xcache));
+    TETRIS_ASSERT(xc != NULL);
+
+    xc->mask = (((uint64_t) 1) << a->xcache_log_n_entries) - 1;
+    xc->entries = (struct xcache_entry *)
+        calloc(xc->mask + 1, sizeof(struct xcache_entry));
+    TETRIS_ASSERT(xc->entries != NULL);
+
+    a->__xcache = xc;
+}
+
+
+static void _xcache_destroy(struct lha_xcache *xc) {
+    free(xc->entries);
+    free(xc);
+}
+
+
+static void _xcache_clear(struct lha_xcache *xc) {
+    memset(xc->entries, 0, (xc->mask + 1) * sizeof(struct xcache_entry));
+}
+
+
+/*
+ * returns 1 if the candidates of game states searched from at this depth may
+ * be cached
+ */
+static int _xcache_usable(lha_t *a, int depth) {
+    return a->__xcache != NULL && !_at_top_level(a, depth) &&
+        !a->timed_lookahead &&
+        a->best_n > 0 && a->best_n <= XCACHE_MAX_CANDS;
+}
+
+
+/*
+ * copies the candidates of key into cands, if they are in the cache
+ *
+ * returns the number of candidates, or -1 if not found
+ */
+static int _xcache_lookup(struct lha_xcache *xc, uint64_t key,
+        uint64_t *cands) {
+    struct xcache_entry * e = &xc->entries[key & xc->mask];
+
+    uint32_t seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+    if ((seq & 1) ||
+            atomic_load_explicit(&e->key, memory_order_relaxed) != key) {
+        return -1;
+    }
+
+    int n = atomic_load_explicit(&e->n_cands, memory_order_relaxed);
+    for (int i = 0; i < n; i++) {
+        cands[i] = atomic_load_explicit(&e->cands[i], memory_order_relaxed);
+    }
+
+    // if the entry was written while we read it, what we read can't be used
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&e->seq, memory_order_relaxed) != seq) {
+        return -1;
+    }
+    return n;
+}
+
+
+static void _xcache_store(struct lha_xcache *xc, uint64_t key,
+        const uint64_t *cands, int n) {
+    struct xcache_entry * e = &xc->entries[key & xc->mask];
+
+    uint32_t seq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+    if ((seq & 1) || !atomic_compare_exchange_strong_explicit(&e->seq, &seq,
+                seq + 1, memory_order_relaxed, memory_order_relaxed)) {
+        // another thread is writing this entry, so let it
+        return;
+    }
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&e->key, key, memory_order_relaxed);
+    atomic_store_explicit(&e->n_cands, n, memory_order_relaxed);
+    for (int i = 0; i < n; i++) {
+        atomic_store_explicit(&e->cands[i], cands[i], memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&e->seq, seq + 2, memory_order_release);
+}
+
+
+static uint64_t _xcache_pack(piece_t p, float h) {
+    uint32_t p_bits, h_bits;
+
+    __builtin_memcpy(&p_bits, &p, sizeof(p_bits));
+    __builtin_memcpy(&h_bits, &h, sizeof(h_bits));
+    return (((uint64_t) h_bits) << 32) | p_bits;
+}
+
+
+static piece_t _xcache_unpack(uint64_t cand, float *h) {
+    uint32_t p_bits = (uint32_t) cand;
+    uint32_t h_bits = (uint32_t) (cand >> 32);
+    piece_t p;
+
+    __builtin_memcpy(&p, &p_bits, sizeof(p));
+    __builtin_memcpy(h, &h_bits, sizeof(*h));
+    return p;
+}
+
+
+/*
+ * searches from s and gives the list of landing spots worth looking further
+ * into, taking them from the expansion cache if s was already expanded
+ *
+ * when the landing spots are the best n, they come sorted from best to worst,
+ * and the heuristic value of the first is written to *first_h. Otherwise
+ * *first_h is set to NAN
+ */
+static state_node * _expand(lha_t *a, struct lha_scratch *sc, tetris_state *s,
+        int depth, state_t *state, float *first_h) {
+
+    uint64_t packed[XCACHE_MAX_CANDS];
+    uint64_t key = 0;
+    int cacheable = _xcache_usable(a, depth);
+
+    *first_h = NAN;
+
+    if (cacheable) {
+        key = _position_key(s);
+        int n = _xcache_lookup(a->__xcache, key, packed);
+
+        if (n >= 0) {
+            tetris_pose pose;
+
+            _search_init(sc, s, depth, state);
+            tetris_pose_get(&pose, s);
+
+            // falling spots are prepended, so go backwards to keep them in
+            // order
+            for (int i = n; i > 0; i--) {
+                float h;
+                pose.falling_piece = _xcache_unpack(packed[i - 1], &h);
+
+                // only spots where the game ends have infinitely bad values
+                pose.state = (h == -INFINITY) ? GAME_OVER : s->state;
+
+                state_node * node = __find_state_node(state, &pose);
+                node->pose = pose;
+                node->parent_idx = -1;
+                __try_falling_spot_append(state, node);
+            }
+
+            if (n > 0) {
+                _xcache_unpack(packed[0], first_h);
+            }
+            return state->falling_spots;
+        }
+    }
+
+    struct lha_arena * arena = _search(a, sc, s, depth, state);
+
+    if (_at_top_level(a, depth) && a->beam_width > 0) {
+        // beam search looks at every landing spot at the top level
+        return state->falling_spots;
+    }
+
+    state_node * cands = _candidates(a, arena, state);
+
+    if (a->best_n > 0) {
+        *first_h = arena->best_n[0].h;
+    }
+
+    if (cacheable) {
+        // _find_best_n left the candidates, in order, in the arena
+        int n = 0;
+        for (; n < a->best_n && arena->best_n[n].node != NULL; n++) {
+            packed[n] = _xcache_pack(arena->best_n[n].node->pose.falling_piece,
+                    arena->best_n[n].h);
+        }
+        _xcache_store(a->__xcache, key, packed, n);
+    }
+
+    return cands;
+}
+
+
+// calculate all places we can go and construct a path to the place with
+// highest heuristic score
+static float _find_best_path(lha_t *a, struct lha_scratch *sc, tetris_state *s,
+        int depth) {
+    state_t state;
+    float first_h;
+
+    state_node * cands = _expand(a, sc, s, depth, &state, &first_h);
+
+    if (depth == 1 && !_at_top_level(a, depth) && !isnan(first_h)) {
+        // the best landing spot was already found and evaluated, and there is
+        // no path to construct to it
+        return first_h;
+    }
+
+    // choose the best place to land of those landing spots, based
+    // on heuristic
+    // the path constructed at the top level points into the top level arena,
+    // which is not searched from again until the path is used up
+    return _choose_best_dst(a, sc, &state, cands, depth);
+}
+
+
+
+/*
+ * parallel lookahead
+ *
+ * the tree of game states looked at by the lookahead is split into tasks, one
+ * for each game state below the top level. Running a task searches from its
+ * game state and pushes a task for each of its candidate landing spots onto
+ * the running thread's work-stealing deque, and the last child of a task to
+ * finish reduces the heuristic values of its siblings into the parent. Since
+ * the reduction goes through the children in the same order the serial search
+ * does, the result does not depend on which thread ran what
+ */
+
+// log2 of the number of tasks which can be made in one search, beyond which
+// the remaining lookahead is done serially by whichever thread gets there
+#define POOL_LOG_N_TASKS 12
+#define POOL_N_TASKS (1 << POOL_LOG_N_TASKS)
+
+
+struct lha_task {
+    // game state to search from, which has depth moves left to look at
+    tetris_state state;
+    int depth;
+
+    // task this is a lookahead from, NULL for the top level
+    struct lha_task * parent;
+
+    // tasks for each of the candidate landing spots, in the order of the
+    // candidate list
+    struct lha_task * children;
+    int n_children;
+
+    // number of children which have not finished yet
+    atomic_int pending;
+
+    // heuristic value of the best landing spot, and its index in children
+    float h;
+    int best;
+
+    // key of this task in the transposition table
+    uint64_t tt_key;
+};
+
+
+struct lha_worker {
+    struct lha_pool * pool;
+
+    // index of this worker in the pool, worker 0 is the thread that called
+    // linear_heuristic_go
+    int idx;
+
+    ws_deque_t deque;
+
+    // scratch space of this worker, which is the agent's for worker 0, and
+    // own_sc for every other worker
+    struct lha_scratch * sc;
+    struct lha_scratch own_sc;
+
+    pthread_t thread;
+};
+
+
+struct lha_pool {
+    lha_t * agent;
+
+    int n_workers;
+    struct lha_worker * workers;
+
+    // slab of POOL_N_TASKS tasks, of which the first n_tasks are in use by
+    // the current search
+    struct lha_task * tasks;
+    atomic_int n_tasks;
+
+    // the top level of the search, which is run by worker 0
+    struct lha_task root;
+    atomic_int root_done;
+
+    // set while a search is going on, workers keep looking for tasks until
+    // this is cleared
+    atomic_int searching;
+    // number of workers which may still be holding a task
+    atomic_int n_busy;
+
+    // protects search_gen and shutdown, which workers wait on between searches
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t search_gen;
+    int shutdown;
+};
+
+
+static struct lha_task * _alloc_tasks(struct lha_pool *pool, int n) {
+    int idx = atomic_fetch_add_explicit(&pool->n_tasks, n,
+            memory_order_relaxed);
+
+    if (idx + n > POOL_N_TASKS) {
+        return NULL;
+    }
+    return &pool->tasks[idx];
+}
+
+
+/*
+ * sets task's heuristic value to the best of its children's
+ */
+static void _task_reduce(struct lha_task *task) {
+    float max_h = -INFINITY;
+    int best = -1;
+
+    for (int i = 0; i < task->n_children; i++) {
+        if (task->children[i].h > max_h) {
+            max_h = task->children[i].h;
+            best = i;
+        }
+    }
+
+    task->h = max_h;
+    task->best = best;
+}
+
+
+/*
+ * marks task as finished with heuristic value h, finishing every ancestor of
+ * task which was only waiting on it
+ */
+static void _task_complete(struct lha_pool *pool, struct lha_task *task,
+        float h) {
+    struct lha_task * parent;
+
+    task->h = h;
+    while ((parent = task->parent) != NULL) {
+        _tt_store(pool->agent, task->tt_key, task->h);
+
+        // the last child to finish is the one to reduce its siblings into the
+        // parent, and the acquire makes all of their heuristic values visible
+        if (atomic_fetch_sub_explicit(&parent->pending, 1,
+                    memory_order_acq_rel) != 1) {
+            return;
+        }
+        _task_reduce(parent);
+        task = parent;
+    }
+
+    atomic_store_explicit(&pool->root_done, 1, memory_order_release);
+}
+
+
+static void _run_task(struct lha_worker *w, struct lha_task *task);
+
+
+/*
+ * makes a child task of parent for each landing spot in cands, and pushes them
+ * onto w's deque
+ *
+ * returns 0 on success, or nonzero if there was no room for the children, in
+ * which case the parent must be searched some other way
+ */
+static int _spawn_children(struct lha_worker *w, struct lha_task *parent,
+        state_t *s, state_node *cands) {
+    struct lha_pool * pool = w->pool;
+    int n = 0;
+
+    for (state_node * fs = cands; fs != LIST_END; fs = fs->next) {
+        n++;
+    }
+
+    if (n == 0) {
+        parent->n_children = 0;
+        _task_reduce(parent);
+        _task_complete(pool, parent, parent->h);
+        return 0;
+    }
+
+    struct lha_task * children = _alloc_tasks(pool, n);
+    if (children == NULL) {
+        return -1;
+    }
+
+    parent->children = children;
+    parent->n_children = n;
+    atomic_store_explicit(&parent->pending, n, memory_order_relaxed);
+
+    int i = 0;
+    for (state_node * fs = cands; fs != LIST_END; fs = fs->next, i++) {
+        struct lha_task * child = &children[i];
+
+        _make_child_state(&child->state, s->game_state, &fs->pose);
+        child->depth = parent->depth - 1;
+        child->parent = parent;
+    }
+
+    // push in reverse, so this worker pops them off in order
+    for (i = n - 1; i >= 0; i--) {
+        if (ws_deque_push(&w->deque, &children[i]) != 0) {
+            // no room left in the deque, so just do it now
+            _run_task(w, &children[i]);
+        }
+    }
+
+    return 0;
+}
+
+
+static void _run_task(struct lha_worker *w, struct lha_task *task) {
+    lha_t * a = w->pool->agent;
+    state_t state;
+    float h;
+
+    task->tt_key = _tt_key(&task->state, task->depth);
+    if (_tt_lookup(a, task->tt_key, &h)) {
+        _task_complete(w->pool, task, h);
+        return;
+    }
+
+    float first_h;
+    state_node * cands = _expand(a, w->sc, &task->state, task->depth,
+            &state, &first_h);
+
+    if (task->depth == 1 && !isnan(first_h)) {
+        // the candidates are sorted, so the first is the best
+        _task_complete(w->pool, task, first_h);
+    }
+    else if (task->depth == 1 ||
+            _spawn_children(w, task, &state, cands) != 0) {
+        state_node * best;
+        h = _best_of(a, w->sc, &state, cands, task->depth, &best);
+        _task_complete(w->pool, task, h);
+    }
+}
+
+
+/*
+ * gives the next task for w to run, from its own deque if there are any, or
+ * stolen from another worker otherwise
+ *
+ * returns NULL if no task was found
+ */
+static struct lha_task * _next_task(struct lha_worker *w) {
+    struct lha_pool * pool = w->pool;
+    struct lha_task * task = (struct lha_task *) ws_deque_pop(&w->deque);
+
+    for (int i = 1; task == NULL && i < pool->n_workers; i++) {
+        struct lha_worker * victim =
+            &pool->workers[(w->idx + i) % pool->n_workers];
+        task = (struct lha_task *) ws_deque_steal(&victim->deque);
+    }
+
+    return task;
+}
+
+
+static void * _worker_main(void *arg) {
+    struct lha_worker * w = (struct lha_worker *) arg;
+    struct lha_pool * pool = w->pool;
+    uint64_t gen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->search_gen == gen && !pool->shutdown) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        gen = pool->search_gen;
+        pthread_mutex_unlock(&pool->lock);
+
+        // announce ourselves before checking whether the search is still going
+        // on, so that either worker 0 waits for us or we see it is over
+        atomic_fetch_add(&pool->n_busy, 1);
+        while (atomic_load(&pool->searching)) {
+            struct lha_task * task = _next_task(w);
+
+            if (task != NULL) {
+                _run_task(w, task);
+            }
+            else {
+                sched_yield();
+            }
+        }
+        atomic_fetch_sub(&pool->n_busy, 1);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+
+/*
+ * gives the agent's thread pool, starting it if this is the first parallel
+ * search
+ *
+ * returns NULL if the pool could not be started
+ */
+static struct lha_pool * _get_pool(lha_t *a) {
+    if (a->__pool != NULL) {
+        return a->__pool;
+    }
+
+    struct lha_pool * pool = (struct lha_pool *)
+        calloc(1, sizeof(struct lha_pool));
+    TETRIS_ASSERT(pool != NULL);
+
+    pool->agent = a;
+    pool->n_workers = a->n_threads;
+    pool->workers = (struct lha_worker *)
+        calloc(pool->n_workers, sizeof(struct lha_worker));
+    pool->tasks = (struct lha_task *)
+        malloc(POOL_N_TASKS * sizeof(struct lha_task));
+    TETRIS_ASSERT(pool->workers != NULL && pool->tasks != NULL);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    // every deque must exist before any worker can try stealing from it
+    for (int i = 0; i < pool->n_workers; i++) {
+        struct lha_worker * w = &pool->workers[i];
+
+        w->pool = pool;
+        w->idx = i;
+        w->sc = (i == 0) ? &a->__scratch : &w->own_sc;
+        if (ws_deque_init(&w->deque, POOL_LOG_N_TASKS) != 0) {
+            TETRIS_ASSERT(0);
+        }
+    }
+
+    for (int i = 1; i < pool->n_workers; i++) {
+        struct lha_worker * w = &pool->workers[i];
+
+        if (pthread_create(&w->thread, NULL, &_worker_main, w) != 0) {
+            // only keep the workers which were started, which is safe since
+            // none of them can be looking at the others until a search starts
+            pool->n_workers = i;
+            break;
+        }
+    }
+
+    a->__pool = pool;
+    return pool;
+}
+
+
+static void _pool_destroy(struct lha_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->n_workers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        _scratch_destroy(&pool->workers[i].own_sc);
+    }
+    for (int i = 0; i < pool->n_workers; i++) {
+        ws_deque_destroy(&pool->workers[i].deque);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+
+    free(pool->tasks);
+    free(pool->workers);
+    free(pool);
+}
+
+
+/*
+ * parallel version of _best_of, for the top level of the search
+ *
+ * returns 0 on success, or nonzero if the search could not be done in
+ * parallel, in which case best and max_h are not written to
+ */
+static int _par_best_of(lha_t *a, state_t *s, state_node *cands, int depth,
+        state_node **best, float *max_h) {
+
+    struct lha_pool * pool = _get_pool(a);
+    struct lha_worker * w = &pool->workers[0];
+    struct lha_task * root = &pool->root;
+
+    if (pool->n_workers <= 1) {
+        return -1;
+    }
+
+    atomic_store(&pool->n_tasks, 0);
+    atomic_store(&pool->root_done, 0);
+    root->depth = depth;
+    root->parent = NULL;
+
+    // the top level was already searched by the caller, so start from its
+    // children
+    if (_spawn_children(w, root, s, cands) != 0) {
+        return -1;
+    }
+
+    atomic_store(&pool->searching, 1);
+    pthread_mutex_lock(&pool->lock);
+    pool->search_gen++;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    while (!atomic_load_explicit(&pool->root_done, memory_order_acquire)) {
+        struct lha_task * task = _next_task(w);
+
+        if (task != NULL) {
+            _run_task(w, task);
+        }
+        else {
+            sched_yield();
+        }
+    }
+
+    // every task has finished, but other workers may still be looking
+    // through the deques, and the slab can't be reused until they stop
+    atomic_store(&pool->searching, 0);
+    while (atomic_load(&pool->n_busy) != 0) {
+        sched_yield();
+    }
+
+    *best = NULL;
+    *max_h = root->h;
+    if (root->best != -1) {
+        *best = cands;
+        for (int i = 0; i < root->best; i++) {
+            *best = (*best)->next;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * beam search
+ *
+ * instead of pruning each game state of the lookahead to its best_n landing
+ * spots, keep only the beam_width best game states of each ply over all
+ * branches, as scored by the heuristic of the placement that led to them. The
+ * cost of the search is then linear in the depth
+ */
+
+struct beam_entry {
+    // game state after the placement this entry was made from
+    tetris_state state;
+
+    // landing spot at the top level this entry descends from
+    state_node * root;
+};
+
+
+struct beam_cand {
+    // where the falling piece of the parent lands
+    tetris_pose pose;
+    float h;
+
+    // index of the parent in the current beam, or -1 for the top level
+    int parent;
+    state_node * root;
+
+    // position in the candidate list, used to break ties in favor of the one
+    // that was found first, as the other searches do
+    int order;
+};
+
+
+struct lha_beam {
+    // current and next beam, both with room for cap entries
+    struct beam_entry * cur;
+    struct beam_entry * next;
+    int cap;
+
+    // candidates for the next beam, with room for cands_cap entries
+    struct beam_cand * cands;
+    int cands_cap;
+};
+
+
+static void _beam_destroy(struct lha_beam *beam) {
+    free(beam->cur);
+    free(beam->next);
+    free(beam->cands);
+    free(beam);
+}
+
+
+/*
+ * gives the agent's beam buffers, making sure they can hold a full beam
+ */
+static struct lha_beam * _get_beam(lha_t *a) {
+    struct lha_beam * beam = a->__beam;
+
+    if (beam == NULL) {
+        beam = (struct lha_beam *) calloc(1, sizeof(struct lha_beam));
+        TETRIS_ASSERT(beam != NULL);
+        a->__beam = beam;
+    }
+
+    if (beam->cap < a->beam_width) {
+        free(beam->cur);
+        free(beam->next);
+        beam->cap = a->beam_width;
+        beam->cur = (struct beam_entry *)
+            malloc(beam->cap * sizeof(struct beam_entry));
+        beam->next = (struct beam_entry *)
+            malloc(beam->cap * sizeof(struct beam_entry));
+        TETRIS_ASSERT(beam->cur != NULL && beam->next != NULL);
+    }
+    return beam;
+}
+
+
+/*
+ * appends a candidate to the beam's candidate list, growing it if necessary
+ */
+static void _beam_add_cand(struct lha_beam *beam, int *n_cands,
+        const tetris_pose *pose, float h, int parent, state_node *root) {
+
+    if (*n_cands == beam->cands_cap) {
+        int cap = (beam->cands_cap == 0) ? 64 : 2 * beam->cands_cap;
+        struct beam_cand * cands = (struct beam_cand *)
+            realloc(beam->cands, cap * sizeof(struct beam_cand));
+        TETRIS_ASSERT(cands != NULL);
+        beam->cands = cands;
+        beam->cands_cap = cap;
+    }
+
+    struct beam_cand * c = &beam->cands[*n_cands];
+    c->pose = *pose;
+    c->h = h;
+    c->parent = parent;
+    c->root = root;
+    c->order = *n_cands;
+    (*n_cands)++;
+}
+
+
+/*
+ * appends every landing spot in the list spots, whose piece lands on b, to
+ * the beam's candidate list, evaluating them a batch at a time. Each came
+ * from the beam entry parent and leads back to root, or to itself if root is
+ * NULL
+ */
+static void _beam_add_spots(lha_t *a, struct lha_beam *beam, int *n_cands,
+        board_t *b, state_node *spots, int parent, state_node *root) {
+    state_node * nodes[LHA_EVAL_BATCH];
+    float hs[LHA_EVAL_BATCH];
+    uint32_t n_batch;
+
+    while ((n_batch = _next_batch(&spots, nodes)) > 0) {
+        _heuristic_batch(a, b, nodes, n_batch, hs);
+
+        for (uint32_t i = 0; i < n_batch; i++) {
+            _beam_add_cand(beam, n_cands, &nodes[i]->pose, hs[i], parent,
+                    (root == NULL) ? nodes[i] : root);
+        }
+    }
+}
+
+
+static int _beam_cand_cmp(const void *p1, const void *p2) {
+    const struct beam_cand * c1 = (const struct beam_cand *) p1;
+    const struct beam_cand * c2 = (const struct beam_cand *) p2;
+
+    // highest heuristic first, then earliest found
+    if (c1->h != c2->h) {
+        return (c1->h > c2->h) ? -1 : 1;
+    }
+    return c1->order - c2->order;
+}
+
+
+/*
+ * beam search version of _best_of for the top level, which looks at every
+ * landing spot of s
+ */
+static float _beam_best_of(lha_t *a, struct lha_scratch *sc, state_t *s,
+        int depth, state_node **best) {
+
+    struct lha_beam * beam = _get_beam(a);
+    int n_cands = 0;
+    int n_beam = 0;
+
+    _beam_add_spots(a, beam, &n_cands, &s->game_state->board,
+            s->falling_spots, -1, NULL);
+
+    for (int ply = 1; ply < depth && n_cands > 0; ply++) {
+        qsort(beam->cands, n_cands, sizeof(struct beam_cand),
+                &_beam_cand_cmp);
+
+        // the best candidates make up the next beam
+        n_beam = MIN(n_cands, a->beam_width);
+        for (int i = 0; i < n_beam; i++) {
+            struct beam_cand * c = &beam->cands[i];
+            tetris_state * parent = (c->parent == -1) ? s->game_state :
+                &beam->cur[c->parent].state;
+
+            _make_child_state(&beam->next[i].state, parent, &c->pose);
+            beam->next[i].root = c->root;
+        }
+
+        struct beam_entry * tmp = beam->cur;
+        beam->cur = beam->next;
+        beam->next = tmp;
+
+        // every game state of the beam is searched in the same arena, since
+        // the candidates keep everything they need from the search
+        n_cands = 0;
+        for (int i = 0; i < n_beam; i++) {
+            state_t state;
+            tetris_state * gs = &beam->cur[i].state;
+
+            _search(a, sc, gs, depth - ply, &state);
+            _beam_add_spots(a, beam, &n_cands, &gs->board,
+                    state.falling_spots, i, beam->cur[i].root);
+        }
+    }
+
+    // the best landing spot of the last ply decides which way to go
+    float max_h = -INFINITY;
+    *best = NULL;
+    for (int i = 0; i < n_cands; i++) {
+        if (beam->cands[i].h > max_h) {
+            max_h = beam->cands[i].h;
+            *best = beam->cands[i].root;
+        }
+    }
+
+    return max_h;
+}
+
+
+
+/*
+ * anytime search
+ *
+ * a decision is started by searching from the falling piece in a copy of the
+ * game state, after which each of the candidate landing spots is searched to
+ * depth 1, then to depth 2, and so on up to a->depth, a little at a time
+ * each frame. The lookahead from each candidate is the same as _depth_find's,
+ * but with an explicit stack in place of recursion, so that it can be paused
+ * after any game state is expanded. When the decision is made, the game has
+ * moved on, so the top level is searched again from where the falling piece is
+ * now, and the best candidate of the deepest complete iteration that can still
+ * be reached is chosen
+ */
+
+/*
+ * a game state of the lookahead from a candidate, corresponding to a call to
+ * _find_best_path
+ */
+struct lha_dfs_frame {
+    tetris_state game_state;
+    state_t state;
+
+    // number of moves left to look at from game_state
+    int depth;
+    uint64_t tt_key;
+
+    // next landing spot to look further into, and the best heuristic value
+    // of the ones already looked into
+    state_node * next;
+    float max_h;
+};
+
+struct lha_decision {
+    // set while a decision is being made
+    int active;
+
+    // frames spent on this decision so far
+    int frames;
+
+    // the game state the decision is being made from, with no falling piece
+    // on the board, and the search of its top level, whose nodes are only
+    // valid for as long as nothing else searches in the top level arena
+    tetris_state game_state;
+    state_t root;
+
+    // candidate landing spots of the top level. These are copied out of the
+    // arena, since they are needed after it has been searched in again
+    tetris_pose * cands;
+    int n_cands;
+    int cands_cap;
+
+    // heuristic value of each candidate in the iteration being searched, and
+    // in the last complete iteration
+    float * h;
+    float * done_h;
+
+    // depth being searched, and the candidate to search next
+    int depth;
+    int next;
+
+    // lookahead from the candidate being searched, with room for stack_cap
+    // frames
+    struct lha_dfs_frame * stack;
+    int n_stack;
+    int stack_cap;
+};
+
+
+static void _decision_destroy(struct lha_decision *dec) {
+    free(dec->stack);
+    free(dec->cands);
+    free(dec->h);
+    free(dec->done_h);
+    free(dec);
+}
+
+
+static struct lha_decision * _get_decision(lha_t *a) {
+    if (a->__decision == NULL) {
+        a->__decision = (struct lha_decision *)
+            calloc(1, sizeof(struct lha_decision));
+        TETRIS_ASSERT(a->__decision != NULL);
+    }
+    return a->__decision;
+}
+
+
+/*
+ * finishes an iteration of the decision, starting the next one
+ */
+static void _decision_next_depth(struct lha_decision *dec) {
+    float * tmp = dec->done_h;
+    dec->done_h = dec->h;
+    dec->h = tmp;
+
+    dec->depth++;
+    dec->next = 0;
+}
+
+
+/*
+ * starts a decision from s, searching its top level and completing the first
+ * iteration, which only looks at the heuristic of each landing spot
+ */
+static void _decision_start(lha_t *a, struct lha_decision *dec,
+        tetris_state *s) {
+    struct lha_scratch * sc = &a->__scratch;
+
+    tetris_state_deep_copy(&dec->game_state, s);
+
+    struct lha_arena * arena = _search(a, sc, &dec->game_state, a->depth,
+            &dec->root);
+    state_node * cands = _candidates(a, arena, &dec->root);
+
+    int n = 0;
+    for (state_node * fs = cands; fs != LIST_END; fs = fs->next) {
+        if (n == dec->cands_cap) {
+            dec->cands_cap = (n == 0) ? 16 : 2 * n;
+            dec->cands = (tetris_pose *) realloc(dec->cands,
+                    dec->cands_cap * sizeof(tetris_pose));
+            dec->h = (float *) realloc(dec->h, dec->cands_cap * sizeof(float));
+            dec->done_h = (float *) realloc(dec->done_h,
+                    dec->cands_cap * sizeof(float));
+            TETRIS_ASSERT(dec->cands != NULL && dec->h != NULL &&
+                    dec->done_h != NULL);
+        }
+
+        dec->cands[n] = fs->pose;
+        dec->h[n] = heuristic(a, &dec->game_state.board, &fs->pose);
+        n++;
+    }
+
+    if (dec->stack_cap < a->depth) {
+        free(dec->stack);
+        dec->stack_cap = a->depth;
+        dec->stack = (struct lha_dfs_frame *)
+            malloc(dec->stack_cap * sizeof(struct lha_dfs_frame));
+        TETRIS_ASSERT(dec->stack != NULL);
+    }
+
+    dec->active = 1;
+    dec->frames = 0;
+    dec->n_stack = 0;
+    dec->n_cands = n;
+    dec->depth = 1;
+    _decision_next_depth(dec);
+}
+
+
+/*
+ * starts looking ahead from the game state after the piece of parent lands at
+ * pose, with depth moves left to look at from parent
+ *
+ * returns 1 if the heuristic value of the lookahead was found right away in
+ * the transposition table, writing it to *h, or 0 if a frame was pushed
+ */
+static int _dfs_push(lha_t *a, struct lha_decision *dec, state_t *parent,
+        const tetris_pose *pose, int depth, float *h) {
+    struct lha_dfs_frame * f = &dec->stack[dec->n_stack];
+
+    _make_child_state(&f->game_state, parent->game_state, pose);
+    f->depth = depth - 1;
+
+    f->tt_key = _tt_key(&f->game_state, f->depth);
+    if (_tt_lookup(a, f->tt_key, h)) {
+        return 1;
+    }
+
+    float first_h;
+    f->next = _expand(a, &a->__scratch, &f->game_state, f->depth, &f->state,
+            &first_h);
+    f->max_h = -INFINITY;
+
+    if (f->depth == 1 && !isnan(first_h)) {
+        // the candidates are sorted, so the first is the best and the others
+        // don't need to be looked at
+        f->next = LIST_END;
+        f->max_h = first_h;
+    }
+    dec->n_stack++;
+    return 0;
+}
+
+
+/*
+ * looks into the next landing spot of the top frame of the stack, or pops it
+ * if it has none left
+ *
+ * returns 1 if the last frame was popped, writing the heuristic value of the
+ * whole lookahead to *h, or 0 if there is more to do
+ */
+static int _dfs_step(lha_t *a, struct lha_decision *dec, float *h) {
+    struct lha_dfs_frame * f = &dec->stack[dec->n_stack - 1];
+    float child_h;
+
+    if (f->depth == 1) {
+        // the last move is cheap enough to look at all at once
+        for (state_node * fs = f->next; fs != LIST_END; fs = fs->next) {
+            child_h = heuristic(a, &f->game_state.board, &fs->pose);
+            f->max_h = MAX(f->max_h, child_h);
+        }
+        f->next = LIST_END;
+    }
+    else if (f->next != LIST_END) {
+        state_node * fs = f->next;
+        f->next = fs->next;
+
+        if (_dfs_push(a, dec, &f->state, &fs->pose, f->depth, &child_h)) {
+            f->max_h = MAX(f->max_h, child_h);
+        }
+        return 0;
+    }
+
+    // every landing spot of this frame has been looked into
+    _tt_store(a, f->tt_key, f->max_h);
+    tetris_state_destroy(&f->game_state);
+    dec->n_stack--;
+
+    if (dec->n_stack == 0) {
+        *h = f->max_h;
+        return 1;
+    }
+    f[-1].max_h = MAX(f[-1].max_h, f->max_h);
+    return 0;
+}
+
+
+/*
+ * does the next bit of searching for the decision
+ *
+ * returns 1 if every iteration is done
+ */
+static int _decision_search_next(lha_t *a, struct lha_decision *dec) {
+    float h;
+    int found;
+
+    if (dec->depth > a->depth || dec->n_cands == 0) {
+        return 1;
+    }
+
+    if (dec->n_stack == 0) {
+        // start on the next candidate
+        found = _dfs_push(a, dec, &dec->root, &dec->cands[dec->next],
+                dec->depth, &h);
+    }
+    else {
+        found = _dfs_step(a, dec, &h);
+    }
+
+    if (found) {
+        dec->h[dec->next++] = h;
+
+        if (dec->next == dec->n_cands) {
+            _decision_next_depth(dec);
+        }
+    }
+    return dec->depth > a->depth;
+}
+
+
+/*
+ * ends the decision, setting a's action list to the path to the best landing
+ * spot that can be reached from s
+ */
+static void _decision_finish(lha_t *a, struct lha_decision *dec,
+        tetris_state *s) {
+    state_t state;
+    state_t * root = &dec->root;
+    state_node * best = NULL;
+
+    dec->active = 0;
+
+    if (s->time != dec->game_state.time ||
+            _get_arena(&a->__scratch, a->depth)->gen != root->gen) {
+        // the falling piece has moved on since the top level was searched, or
+        // something else has searched in its arena since, so search it again
+        // from where the piece is now
+        _search(a, &a->__scratch, s, a->depth, &state);
+        root = &state;
+    }
+
+    // take the best candidate which is still a falling spot, breaking ties in
+    // favor of the one that comes first
+    float max_h = -INFINITY;
+    for (int i = 0; i < dec->n_cands; i++) {
+        state_node * node = __find_state_node(root, &dec->cands[i]);
+
+        if (node->next != NULL && (best == NULL || dec->done_h[i] > max_h)) {
+            max_h = dec->done_h[i];
+            best = node;
+        }
+    }
+
+    if (best == NULL) {
+        // none of the candidates can be reached anymore, so just go for the
+        // best landing spot there is now
+        _best_of(a, &a->__scratch, root, root->falling_spots, 1, &best);
+    }
+
+    if (best != NULL) {
+        _ponder_post(a, root, best);
+        a->__int_state.action_list = _construct_path_to(root, best);
+    }
+}
+
+
+/*
+ * makes progress on the decision for the falling piece in s within the frame
+ * budget, setting a's action list if the decision was made
+ */
+static void _decision_step(lha_t *a, tetris_state *s) {
+    struct lha_decision * dec = _get_decision(a);
+    uint64_t start = tetris_time_ns();
+
+    if (dec->active && dec->game_state.queue_idx != s->queue_idx) {
+        // the piece the decision was for is gone
+        dec->active = 0;
+    }
+
+    if (!dec->active) {
+        _decision_start(a, dec, s);
+    }
+
+    int done = 0;
+    while (!done && tetris_time_ns() - start < a->frame_budget_ns) {
+        done = _decision_search_next(a, dec);
+    }
+
+    // once the piece is on the ground, it will soon stick
+    piece_t below = s->falling_piece;
+    piece_move(&below, 0, -1);
+
+    dec->frames++;
+    if (done || dec->frames >= a->max_think_frames ||
+            board_piece_collides(&s->board, below)) {
+        _decision_finish(a, dec, s);
+    }
+}
+
+
+
+/*
+ * pondering
+ *
+ * once the path for the falling piece is chosen, the game state after it
+ * lands is known (as long as the game plays out the way the search expects),
+ * so a background thread searches from there while the piece falls. The
+ * landing spot it chooses is handed back through a single slot, which the game
+ * thread only swaps out when it needs a decision. If the game state the next
+ * decision is for is in the same position the thread searched from, only the
+ * top level has to be searched again, to find the path to that landing spot
+ */
+
+struct ponder_result {
+    // ponder key of the game state the search was from
+    uint64_t key;
+
+    // chosen landing spot
+    tetris_pose pose;
+};
+
+
+struct lha_ponder {
+    pthread_t thread;
+
+    // scratch space of the pondering thread
+    struct lha_scratch sc;
+
+    // protects everything below it up to slot. The game thread posts a game
+    // state to search from by copying it into req_state and incrementing
+    // req_gen
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    tetris_state req_state;
+    uint64_t req_gen;
+    int shutdown;
+    // set while the thread is searching, and cond is broadcast when it is
+    // cleared
+    int busy;
+
+    // copy of req_gen which can be read without the lock, so that searches
+    // which have been superseded can be abandoned
+    _Atomic uint64_t cur_gen;
+
+    // the latest result, which is owned by whichever thread swaps it out
+    _Atomic(struct ponder_result *) slot;
+};
+
+
+/*
+ * gives the key of the position of s as far as pondering is concerned. This is
+ * the position key without the pose of the falling piece, since the piece may
+ * already have moved by the time the game thread takes the result of
+ * pondering, e.g. by falling during the lock delay of the previous piece
+ */
+static uint64_t _ponder_key(tetris_state *s) {
+    uint64_t queue[2] = { 0, 0 };
+    __builtin_memcpy(queue, s->piece_queue, sizeof(s->piece_queue));
+
+    uint64_t extra =
+        ((uint64_t) s->falling_piece.piece_idx) |
+        (((uint64_t) s->hold.piece_idx) << 8) |
+        (((uint64_t) (s->hold.flags & PIECE_HOLD_STALE)) << 16) |
+        (((uint64_t) s->queue_idx) << 24);
+
+    uint64_t key = board_hash(&s->board) ^ tetris_hash_mix(~extra);
+    key = tetris_hash_mix(key ^ queue[0]);
+    key = tetris_hash_mix(key ^ queue[1]);
+    key = tetris_hash_mix(key ^ s->state);
+
+    return key;
+}
+
+
+/*
+ * searches from gs the same way the top level of the lookahead would
+ *
+ * returns 0 if the search finished, writing its result to *res, or nonzero if
+ * it was abandoned because a newer game state was posted
+ */
+static int _ponder_search(lha_t *a, struct lha_ponder *p, tetris_state *gs,
+        uint64_t gen, struct ponder_result *res) {
+    state_t state;
+    state_node * best = NULL;
+    float max_h = -INFINITY;
+
+    struct lha_arena * arena = _search(a, &p->sc, gs, a->depth, &state);
+    state_node * cands = _candidates(a, arena, &state);
+
+    for (state_node * fs = cands; fs != LIST_END; fs = fs->next) {
+        if (atomic_load_explicit(&p->cur_gen, memory_order_relaxed) != gen) {
+            return -1;
+        }
+
+        float h;
+        if (a->depth == 1) {
+            h = heuristic(a, &gs->board, &fs->pose);
+        }
+        else {
+            h = _depth_find(a, &p->sc, &state, fs, a->depth);
+        }
+
+        if (h > max_h || best == NULL) {
+            max_h = h;
+            best = fs;
+        }
+    }
+
+    if (best == NULL) {
+        return -1;
+    }
+
+    res->key = _ponder_key(gs);
+    res->pose = best->pose;
+    return 0;
+}
+
+
+static void * _ponder_main(void *arg) {
+    lha_t * a = (lha_t *) arg;
+    struct lha_ponder * p = a->__ponder;
+    tetris_state gs;
+    uint64_t gen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (1) {
+        while (p->req_gen == gen && !p->shutdown) {
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+        if (p->shutdown) {
+            break;
+        }
+        gen = p->req_gen;
+        tetris_state_deep_copy(&gs, &p->req_state);
+        p->busy = 1;
+        pthread_mutex_unlock(&p->lock);
+
+        struct ponder_result * res = (struct ponder_result *)
+            malloc(sizeof(struct ponder_result));
+        TETRIS_ASSERT(res != NULL);
+
+        if (_ponder_search(a, p, &gs, gen, res) == 0) {
+            // publish the result, throwing out the last one if the game
+            // thread never took it
+            res = atomic_exchange_explicit(&p->slot, res,
+                    memory_order_acq_rel);
+        }
+        free(res);
+        tetris_state_destroy(&gs);
+
+        pthread_mutex_lock(&p->lock);
+        p->busy = 0;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+
+/*
+ * gives the agent's pondering thread, starting it if it isn't running yet
+ *
+ * returns NULL if the thread could not be started
+ */
+static struct lha_ponder * _get_ponder(lha_t *a) {
+    if (a->__ponder != NULL) {
+        return a->__ponder;
+    }
+
+    struct lha_ponder * p = (struct lha_ponder *)
+        calloc(1, sizeof(struct lha_ponder));
+    TETRIS_ASSERT(p != NULL);
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    atomic_init(&p->cur_gen, 0);
+    atomic_init(&p->slot, NULL);
+
+    a->__ponder = p;
+    if (pthread_create(&p->thread, NULL, &_ponder_main, a) != 0) {
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->cond);
+        free(p);
+        a->__ponder = NULL;
+    }
+    return a->__ponder;
+}
+
+
+static void _ponder_destroy(struct lha_ponder *p) {
+    pthread_mutex_lock(&p->lock);
+    p->shutdown = 1;
+    atomic_store(&p->cur_gen, p->req_gen + 1);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+
+    pthread_join(p->thread, NULL);
+
+    free(atomic_load(&p->slot));
+    if (p->req_gen != 0) {
+        tetris_state_destroy(&p->req_state);
+    }
+    _scratch_destroy(&p->sc);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    free(p);
+}
+
+
+/*
+ * abandons whatever the pondering thread is searching and waits for it to go
+ * idle, throwing out any result it has posted, so that the agent's shared
+ * tables can be modified. Pondering resumes with the next _ponder_post
+ */
+static void _ponder_quiesce(struct lha_ponder *p) {
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->cur_gen, p->req_gen + 1);
+    while (p->busy) {
+        pthread_cond_wait(&p->cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    free(atomic_exchange(&p->slot, NULL));
+}
+
+
+/*
+ * starts pondering the game state after the falling piece of s->game_state
+ * lands at best, if pondering is enabled
+ */
+static void _ponder_post(lha_t *a, state_t *s, state_node *best) {
+    if (!a->ponder) {
+        return;
+    }
+
+    struct lha_ponder * p = _get_ponder(a);
+    if (p == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if (p->req_gen != 0) {
+        tetris_state_destroy(&p->req_state);
+    }
+    _make_child_state(&p->req_state, s->game_state, &best->pose);
+    p->req_gen++;
+    atomic_store_explicit(&p->cur_gen, p->req_gen, memory_order_relaxed);
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+
+/*
+ * takes the result of pondering, if there is one for the position of s, and
+ * sets a's action list to the path to the landing spot it chose
+ *
+ * returns 1 if a path was found this way, 0 if the agent has to search
+ */
+static int _ponder_take(lha_t *a, tetris_state *s) {
+    if (a->__ponder == NULL) {
+        return 0;
+    }
+
+    struct ponder_result * res = atomic_exchange_explicit(&a->__ponder->slot,
+            NULL, memory_order_acq_rel);
+    if (res == NULL) {
+        return 0;
+    }
+
+    int found = 0;
+    if (res->key == _ponder_key(s)) {
+        state_t state;
+
+        // the timing of the game may not be what the pondering thread
+        // expected, so find the path to its landing spot from scratch
+        _search(a, &a->__scratch, s, a->depth, &state);
+        state_node * node = __find_state_node(&state, &res->pose);
+
+        if (node->next != NULL) {
+            _ponder_post(a, &state, node);
+            a->__int_state.action_list = _construct_path_to(&state, node);
+            found = 1;
+        }
+    }
+
+    free(res);
+    return found;
+}
+
+
+
+/*
+ * try to perform an action, doing so if the next action in the queue is ready,
+ * otherwise wait
+ *
+ * return 1 if the action could be performed, 0 if we are waiting
+ */
+int _try_move(lha_t *a, state_node * action, tetris_state *s) {
+
+    if (s->state == PLAY && action->cb_time <= s->time) {
+        // time to perform the action
+        int ret = 1;
+
+        if (!tetris_state_is_transient(s)) {
+            tetris_remove_falling_piece(s);
+        }
+        switch (action->action) {
+            case GO_LEFT:
+                tetris_move_piece_transient(s, -1, 0);
+                break;
+            case GO_RIGHT:
+                tetris_move_piece_transient(s, 1, 0);
+                break;
+            case GO_DOWN:
+                tetris_move_piece_transient(s, 0, -1);
+                break;
             case ROTATE_C:
                 tetris_rotate_piece_transient(s, ROTATE_CLOCKWISE, 1);
                 break;
@@ -755,7 +2708,7 @@ int _try_move(state_node * action, tetris_state *s) {
                 tetris_rotate_piece_transient(s, ROTATE_COUNTERCLOCKWISE, 1);
                 break;
             case WAIT:
-                if (piece_equals(action->game_state.falling_piece,
+                if (piece_equals(action->pose.falling_piece,
                             s->falling_piece)) {
                     // wait until the falling pieces are different
                     ret = 0;
@@ -763,9 +2716,9 @@ int _try_move(state_node * action, tetris_state *s) {
                 else {
                     // only wait for gravity/stick, so piece must either now be
                     // different, or below us
-                    TETRIS_ASSERT(action->game_state.queue_idx !=
+                    TETRIS_ASSERT(a->__int_state.queue_idx !=
                                 s->queue_idx ||
-                            action->game_state.falling_piece.board_y >
+                            action->pose.falling_piece.board_y >
                                 s->falling_piece.board_y);
                 }
                 break;
@@ -787,6 +2740,12 @@ int _try_move(state_node * action, tetris_state *s) {
 int linear_heuristic_go(lha_t *a, tetris_state *s) {
     state_node * next_action;
 
+    // the anytime search does not know how to do beam search
+    TETRIS_ASSERT(a->beam_width == 0 || a->frame_budget_ns == 0);
+
+    _init_tt(a);
+    _init_xcache(a);
+
     // do this at most 2 times
     for (int i = 0; i < 2; i++) {
         if (a->__int_state.action_list == NULL) {
@@ -798,7 +2757,20 @@ int linear_heuristic_go(lha_t *a, tetris_state *s) {
                 board_remove_piece(&s->board, s->falling_piece);
             }
 
-            _find_best_path(a, s, a->depth);
+            if (_ponder_take(a, s)) {
+                // the decision was already made in the background, so any
+                // decision being made for the piece is moot
+                if (a->__decision != NULL) {
+                    a->__decision->active = 0;
+                }
+            }
+            else if (a->frame_budget_ns == 0) {
+                _find_best_path(a, &a->__scratch, s, a->depth);
+            }
+            else {
+                _decision_step(a, s);
+            }
+            a->__int_state.queue_idx = s->queue_idx;
 
             if (!tetris_state_is_transient(s)) {
                 // place the falling piece back on the board
@@ -807,18 +2779,15 @@ int linear_heuristic_go(lha_t *a, tetris_state *s) {
         }
 
         next_action = a->__int_state.action_list;
-        if (next_action == NULL) {
-            if (a->__int_state.to_free != NULL) {
-                free(a->__int_state.to_free);
-                a->__int_state.to_free = NULL;
-            }
+        if (next_action == NULL && (a->__decision == NULL ||
+                    !a->__decision->active)) {
             continue;
         }
 
         break;
     }
 
-    while (next_action != NULL && _try_move(next_action, s)) {
+    while (next_action != NULL && _try_move(a, next_action, s)) {
         // TODO assert piece position
 
         // remove action from the action list
@@ -54,6 +54,257 @@ static int _board_is_grayed(board_t *b) {
 
 
 
+/*
+ * gives the occupancy of row y in the same layout as piece row masks (see
+ * piece_row_masks), with the imaginary walls on either side of the board and
+ * the floor below it counted as filled
+ */
+static uint32_t _board_row_bits(board_t *b, int32_t y) {
+    uint32_t walls = ~(((uint32_t) b->full_row) << PIECE_MASK_OFF);
+
+    if (y < 0) {
+        // below the floor
+        return ~0U;
+    }
+    if (y >= (int32_t) b->height) {
+        // above the top of the board, only the walls are filled
+        return walls;
+    }
+    return walls | (((uint32_t) b->row_masks[y]) << PIECE_MASK_OFF);
+}
+
+
+/*
+ * returns 1 if the piece's bounding box is so far to the left or right that
+ * none of its tiles could be on the board (these pieces can't be represented
+ * by piece row masks)
+ */
+static int _piece_out_of_range(board_t *b, piece_t piece) {
+    return piece.board_x < -PIECE_MASK_OFF ||
+        piece.board_x >= (int32_t) b->width;
+}
+
+
+/*
+ * gives the height column col would have if only rows below row were
+ * considered
+ */
+static uint8_t _col_height_below(board_t *b, int32_t col, int32_t row) {
+    for (int32_t y = row - 1; y >= 0; y--) {
+        if ((b->row_masks[y] >> col) & 1) {
+            return y + 1;
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * adds inc to each element of col_stats whose column bit is set in cols
+ */
+static void _add_to_cols(uint8_t *col_stats, uint32_t cols, int inc) {
+    for (; cols != 0; cols &= cols - 1) {
+        col_stats[__builtin_ctz(cols)] += inc;
+    }
+}
+
+
+/*
+ * key of row y having occupancy row in the board hash
+ */
+static uint64_t _row_key(int32_t y, row_mask_t row) {
+    return (row == 0) ? 0 :
+        tetris_hash_mix((((uint64_t) y) << (8 * sizeof(row_mask_t))) | row);
+}
+
+
+/*
+ * recomputes the column heights, hole counts, full row count, tile and
+ * transition counts and hash from scratch from the row masks
+ */
+static void _board_recompute_cols(board_t *b) {
+    row_mask_t full_row = b->full_row;
+    // columns which have had an occupied tile found in them so far
+    row_mask_t seen = 0;
+
+    memset(b->col_heights, 0, sizeof(b->col_heights));
+    memset(b->col_holes, 0, sizeof(b->col_holes));
+    b->n_full_rows = 0;
+    b->n_filled = 0;
+    b->row_transitions = 0;
+    b->col_transitions = 0;
+    b->hash = 0;
+
+    for (int32_t y = b->height - 1; y >= 0; y--) {
+        row_mask_t row = b->row_masks[y];
+
+        // first tile in each column that is occupied (from top to bottom)
+        // gives the height of the column
+        for (uint32_t tops = row & ~seen; tops != 0; tops &= tops - 1) {
+            b->col_heights[__builtin_ctz(tops)] = y + 1;
+        }
+        seen |= row;
+
+        if (y + 1 < b->height) {
+            _add_to_cols(b->col_holes, ~row & b->row_masks[y + 1] & full_row,
+                    1);
+        }
+
+        b->n_full_rows += (row == full_row);
+        b->n_filled += __builtin_popcount(row & full_row);
+        b->row_transitions +=
+            __builtin_popcount(board_row_transition_bits(row, full_row));
+        // the floor counts as occupied
+        b->col_transitions += __builtin_popcount((row ^ ((y > 0) ?
+                        b->row_masks[y - 1] : full_row)) & full_row);
+        b->hash ^= _row_key(y, row);
+    }
+}
+
+
+/*
+ * sets the row mask of row y (which must be on the board) to new_row, updating
+ * the column heights, hole counts, full row count, tile and transition counts
+ * and hash to match
+ */
+static void _board_set_row_mask(board_t *b, int32_t y, row_mask_t new_row) {
+    row_mask_t old_row = b->row_masks[y];
+    row_mask_t changed = old_row ^ new_row;
+    row_mask_t full_row = b->full_row;
+
+    if (changed == 0) {
+        return;
+    }
+
+    // empty tiles directly below this row, and occupied tiles directly above
+    // it (the floor counts as occupied and above the board as empty)
+    row_mask_t below_empty = (y > 0) ? (~b->row_masks[y - 1] & full_row) : 0;
+    row_mask_t above = (y + 1 < b->height) ? b->row_masks[y + 1] : 0;
+
+    // tiles below newly occupied tiles become holes and tiles below newly
+    // emptied tiles stop being holes, and the opposite for the tiles of this
+    // row itself
+    _add_to_cols(b->col_holes, changed & new_row & below_empty, 1);
+    _add_to_cols(b->col_holes, changed & old_row & below_empty, -1);
+    _add_to_cols(b->col_holes, changed & old_row & above, 1);
+    _add_to_cols(b->col_holes, changed & new_row & above, -1);
+
+    b->n_full_rows += (new_row == full_row) - (old_row == full_row);
+    b->n_filled += __builtin_popcount(new_row & full_row) -
+        __builtin_popcount(old_row & full_row);
+    b->row_transitions +=
+        __builtin_popcount(board_row_transition_bits(new_row, full_row)) -
+        __builtin_popcount(board_row_transition_bits(old_row, full_row));
+
+    // the floor counts as occupied, and the top of the board doesn't count
+    row_mask_t below = (y > 0) ? b->row_masks[y - 1] : full_row;
+    b->col_transitions += __builtin_popcount((new_row ^ below) & full_row) -
+        __builtin_popcount((old_row ^ below) & full_row);
+    if (y + 1 < b->height) {
+        b->col_transitions += __builtin_popcount((new_row ^ above) & full_row) -
+            __builtin_popcount((old_row ^ above) & full_row);
+    }
+
+    b->hash ^= _row_key(y, old_row) ^ _row_key(y, new_row);
+
+    b->row_masks[y] = new_row;
+
+    for (uint32_t cols = changed; cols != 0; cols &= cols - 1) {
+        int32_t col = __builtin_ctz(cols);
+
+        if ((new_row >> col) & 1) {
+            if (b->col_heights[col] < y + 1) {
+                b->col_heights[col] = y + 1;
+            }
+        }
+        else if (b->col_heights[col] == y + 1) {
+            // the topmost tile of this column was removed, so we have to look
+            // for the next one down
+            b->col_heights[col] = _col_height_below(b, col, y);
+        }
+    }
+}
+
+
+/*
+ * gives the packed color indices of row y, which must be on the board
+ */
+static row_colors_t * _board_row_colors(board_t *b, int32_t y) {
+    return &b->row_colors[b->row_map[y]];
+}
+
+
+/*
+ * gives the color index of tile (x, y), which must be on the board
+ */
+static uint32_t _get_color_idx(board_t *b, int32_t x, int32_t y) {
+    return (*_board_row_colors(b, y) >> (x * LOG_N_STATES)) & COLOR_IDX_MASK;
+}
+
+
+/*
+ * sets the color index of tile (x, y), which must be on the board, without
+ * touching the row masks
+ */
+static void _set_color_idx(board_t *b, int32_t x, int32_t y,
+        uint32_t tile_color) {
+    row_colors_t *row = _board_row_colors(b, y);
+    uint32_t shift = x * LOG_N_STATES;
+
+    *row = (*row & ~(((row_colors_t) COLOR_IDX_MASK) << shift)) |
+        (((row_colors_t) tile_color) << shift);
+}
+
+
+/*
+ * sets each tile of row y whose bit is set in tiles to tile_color, where y
+ * must be a row on the board
+ */
+static void _board_fill_row(board_t *b, int32_t y, row_mask_t tiles,
+        uint32_t tile_color) {
+    for (uint32_t t = tiles; t != 0; t &= t - 1) {
+        _set_color_idx(b, __builtin_ctz(t), y, tile_color);
+    }
+
+    _board_set_row_mask(b, y, (tile_color != EMPTY) ?
+            (b->row_masks[y] | tiles) :
+            (b->row_masks[y] & ~tiles));
+}
+
+
+/*
+ * sets each tile of the piece which is on the board to tile_color
+ *
+ * returns 1 if any tile of the piece was on the board, otherwise 0
+ */
+static int _board_fill_piece(board_t *b, piece_t piece, uint32_t tile_color) {
+    int piece_placed = 0;
+
+    if (_piece_out_of_range(b, piece)) {
+        return 0;
+    }
+
+    const uint32_t *masks = piece_row_masks(piece);
+
+    for (int32_t r = 0; r < PIECE_BB_H; r++) {
+        int32_t y = piece.board_y + r;
+        row_mask_t tiles = (masks[r] >> PIECE_MASK_OFF) & b->full_row;
+
+        if (((uint32_t) y) < b->height && tiles != 0) {
+            _board_fill_row(b, y, tiles, tile_color);
+            piece_placed = 1;
+        }
+    }
+
+    if (piece_placed) {
+        _set_board_changed(b);
+    }
+
+    return piece_placed;
+}
+
+
+
 /*
  * places shadow of falling piece on the board (where it would stick if it were
  * left to fall all the way), and writes back the shadow piece into falling_piece
@@ -64,43 +315,13 @@ static int _board_is_grayed(board_t *b) {
  */
 void board_place_shadow(board_t *b, piece_t *falling_piece) {
     piece_t fp = *falling_piece;
-    define_each_piece_tile(p, fp);
-
-    // does board_remove_piece(b, fp) without redefining piece indices
-    board_set_tile(b, p_x1, p_y1, EMPTY);
-    board_set_tile(b, p_x2, p_y2, EMPTY);
-    board_set_tile(b, p_x3, p_y3, EMPTY);
-    board_set_tile(b, p_x4, p_y4, EMPTY);
-
-    while (1) {
-        fp.board_y--;
-        p_y1--;
-        p_y2--;
-        p_y3--;
-        p_y4--;
-        if (p_y1 < 0 ||
-                board_get_tile(b, p_x1, p_y1) ||
-                board_get_tile(b, p_x2, p_y2) ||
-                board_get_tile(b, p_x3, p_y3) ||
-                board_get_tile(b, p_x4, p_y4)) {
-            // if either the lower left corner of the tile is below the board
-            // (p_y1 < 0) or even one of the tiles can't be placed here, then
-            // the previous spot is where the shadow goes
-            fp.board_y++;
-            p_y1++;
-            p_y2++;
-            p_y3++;
-            p_y4++;
-            break;
-        }
-    }
 
-    uint32_t tile_color = PIECE_SHADOW | fp.piece_idx;
+    board_remove_piece(b, fp);
+
+    // the shadow goes wherever the piece would land
+    fp.board_y = board_landing_row(b, fp);
 
-    board_set_tile(b, p_x1, p_y1, tile_color);
-    board_set_tile(b, p_x2, p_y2, tile_color);
-    board_set_tile(b, p_x3, p_y3, tile_color);
-    board_set_tile(b, p_x4, p_y4, tile_color);
+    _board_fill_piece(b, fp, PIECE_SHADOW | fp.piece_idx);
 
     // put the falling piece back
     board_place_piece(b, *falling_piece);
@@ -112,12 +333,21 @@ void board_place_shadow(board_t *b, piece_t *falling_piece) {
  * removes shadow of the falling piece
  */
 void board_remove_shadow(board_t *b, piece_t falling_piece) {
-    define_each_piece_tile(p, falling_piece);
+    if (_piece_out_of_range(b, falling_piece)) {
+        return;
+    }
 
-    board_unset_shadow_tile(b, p_x1, p_y1);
-    board_unset_shadow_tile(b, p_x2, p_y2);
-    board_unset_shadow_tile(b, p_x3, p_y3);
-    board_unset_shadow_tile(b, p_x4, p_y4);
+    const uint32_t *masks = piece_row_masks(falling_piece);
+
+    for (int32_t r = 0; r < PIECE_BB_H; r++) {
+        int32_t y = falling_piece.board_y + r;
+        uint32_t tiles = masks[r] >> PIECE_MASK_OFF;
+
+        while (tiles != 0) {
+            board_unset_shadow_tile(b, __builtin_ctz(tiles), y);
+            tiles &= tiles - 1;
+        }
+    }
 }
 
 
@@ -175,11 +405,21 @@ const static color_t color_theme[4 * N_COLORS] = {
 
 
 int board_init(board_t *b, uint32_t width, uint32_t height, int do_graphics) {
-    uint32_t color_idxs_len = color_idxs_arr_len(width * height);
-    b->color_idxs = (uint32_t*) calloc(color_idxs_len, sizeof(uint32_t));
+    TETRIS_ASSERT(width <= BOARD_MAX_WIDTH);
+    TETRIS_ASSERT(height <= BOARD_MAX_HEIGHT);
+
+    memset(b->row_colors, 0, sizeof(b->row_colors));
+    memset(b->row_masks, 0, sizeof(b->row_masks));
+    for (uint32_t y = 0; y < BOARD_MAX_HEIGHT; y++) {
+        b->row_map[y] = y;
+    }
 
     b->width = width;
     b->height = height;
+    b->full_row = (row_mask_t) ((1U << width) - 1);
+
+    // the board starts off empty
+    _board_recompute_cols(b);
 
     if (do_graphics) {
         gl_load_program(&b->p, "main/res/board.vs", "main/res/board.fs");
@@ -229,7 +469,6 @@ int board_init(board_t *b, uint32_t width, uint32_t height, int do_graphics) {
 }
 
 void board_destroy(board_t *b) {
-    free(b->color_idxs);
     if (!(b->flags & BOARD_COPY) && (b->flags & BOARD_DO_GRAPHICS)) {
         // only original board is responsible for cleaning this up
         shape_destroy(&b->tile_prot);
@@ -239,33 +478,17 @@ void board_destroy(board_t *b) {
 
 
 void board_deep_copy(board_t *dst, const board_t *src) {
-
-    uint32_t width = src->width;
-    uint32_t height = src->height;
-    uint32_t color_idxs_len = color_idxs_arr_len(width * height);
-
-    uint32_t * color_idxs =
-        (uint32_t*) malloc(color_idxs_len * sizeof(uint32_t));
-
-    if (color_idxs == NULL) {
-        fprintf(stderr, "Unable to copy board %p\n", src);
-        return;
-    }
-
-    // copy old board over
-    __builtin_memcpy(color_idxs, src->color_idxs,
-            color_idxs_len * sizeof(uint32_t));
-
+    // the tiles are all stored inline, so copying the struct copies them too
     __builtin_memcpy(dst, src, sizeof(board_t));
-    dst->color_idxs = color_idxs;
     dst->flags |= BOARD_COPY;
 }
 
 
 
 void board_clear(board_t *b) {
-    memset(b->color_idxs, 0, color_idxs_arr_len(b->width * b->height) *
-            sizeof(uint32_t));
+    memset(b->row_colors, 0, sizeof(b->row_colors));
+    memset(b->row_masks, 0, b->height * sizeof(row_mask_t));
+    _board_recompute_cols(b);
     _set_board_changed(b);
 }
 
@@ -282,14 +505,11 @@ int board_set_tile(board_t *b, int32_t x, int32_t y,
 
     _set_board_changed(b);
 
-    uint32_t idx = y * b->width + x;
-    uint32_t color_idx = idx / COLOR_IDXS_PER_INT;
-    uint32_t el_idx = idx - (color_idx * COLOR_IDXS_PER_INT);
+    // the tile is occupied iff it is not EMPTY
+    row_mask_t occ = (row_mask_t) ((tile_color != EMPTY) << x);
+    _board_set_row_mask(b, y, (b->row_masks[y] & ~(1U << x)) | occ);
 
-    uint32_t mask = COLOR_IDX_MASK << (el_idx * LOG_N_STATES);
-    tile_color <<= el_idx * LOG_N_STATES;
-    b->color_idxs[color_idx] = (b->color_idxs[color_idx] & ~mask) |
-        tile_color;
+    _set_color_idx(b, x, y, tile_color);
     return 1;
 }
 
@@ -305,19 +525,13 @@ int board_unset_shadow_tile(board_t *b, int32_t x, int32_t y) {
         return 0;
     }
 
-    uint32_t idx = y * b->width + x;
-    uint32_t color_idx = idx / COLOR_IDXS_PER_INT;
-    uint32_t el_idx = idx - (color_idx * COLOR_IDXS_PER_INT);
-
-    uint32_t tile = b->color_idxs[color_idx] >> (el_idx * LOG_N_STATES);
-    tile &= COLOR_IDX_MASK;
-    if (!(tile & PIECE_SHADOW)) {
+    if (!(_get_color_idx(b, x, y) & PIECE_SHADOW)) {
         // tile is not a shadow
         return 0;
     }
     // mark tile as empty
-    uint32_t mask = COLOR_IDX_MASK << (el_idx * LOG_N_STATES);
-    b->color_idxs[color_idx] = b->color_idxs[color_idx] & ~mask;
+    _set_color_idx(b, x, y, EMPTY);
+    _board_set_row_mask(b, y, b->row_masks[y] & ~(1U << x));
     return 1;
 }
 
@@ -332,12 +546,7 @@ uint8_t board_get_tile(board_t *b, int32_t x, int32_t y) {
         return (((uint32_t) x) < b->width && y >= 0) ? EMPTY : 1;
     }
 
-    uint32_t idx = y * b->width + x;
-    uint32_t color_idx = idx / COLOR_IDXS_PER_INT;
-    uint32_t el_idx = idx - (color_idx * COLOR_IDXS_PER_INT);
-
-    uint32_t set = b->color_idxs[color_idx] >> (el_idx * LOG_N_STATES);
-    return set & COLOR_IDX_MASK;
+    return _get_color_idx(b, x, y);
 }
 
 
@@ -345,29 +554,133 @@ uint8_t board_get_tile(board_t *b, int32_t x, int32_t y) {
  * retusn 1 if the given row is full on the board (all nonzero entries), else 0
  */
 int board_row_full(board_t *b, int32_t row) {
-    for (int32_t col = 0; col < b->width; col++) {
-        if (board_get_tile(b, col, row) == EMPTY) {
-            return 0;
-        }
+    if (((uint32_t) row) >= b->height) {
+        // everything below the board counts as filled, and everything above
+        // it as empty
+        return row < 0;
     }
-    return 1;
+    return b->row_masks[row] == b->full_row;
 }
 
 
 /*
  * copies the entirety of src_row into dst_row
- * TODO optimize
  */
 void board_copy_row(board_t *b, int32_t dst_row, int32_t src_row) {
-    for (int32_t col = 0; col < b->width; col++) {
-        board_set_tile(b, col, dst_row, board_get_tile(b, col, src_row));
-    }
+    TETRIS_ASSERT(((uint32_t) dst_row) < b->height &&
+            ((uint32_t) src_row) < b->height);
+
+    *_board_row_colors(b, dst_row) = *_board_row_colors(b, src_row);
+    _board_set_row_mask(b, dst_row, b->row_masks[src_row]);
+
+    _set_board_changed(b);
 }
 
 void board_clear_row(board_t *b, int32_t row) {
-    for (int32_t col = 0; col < b->width; col++) {
-        board_set_tile(b, col, row, EMPTY);
+    TETRIS_ASSERT(((uint32_t) row) < b->height);
+
+    *_board_row_colors(b, row) = 0;
+    _board_set_row_mask(b, row, 0);
+
+    _set_board_changed(b);
+}
+
+
+/*
+ * removes each row start_row + i for which bit i of rows is set, dropping the
+ * rows above them down to fill the gaps and filling the top of the board with
+ * empty rows
+ */
+void board_remove_rows(board_t *b, int32_t start_row, uint32_t rows) {
+    int32_t height = b->height;
+    // where the next kept row is to be moved to
+    int32_t dst_row = start_row;
+
+    // storage of the removed rows, which is reused for the empty rows put at
+    // the top of the board
+    uint8_t free_rows[BOARD_MAX_HEIGHT];
+    uint32_t n_free = 0;
+
+    if (rows == 0) {
+        return;
+    }
+
+    TETRIS_ASSERT(start_row >= 0 &&
+            start_row + 31 - __builtin_clz(rows) < height);
+
+    for (int32_t y = start_row; y < height; y++) {
+        uint32_t i = y - start_row;
+
+        if (i < 32 && ((rows >> i) & 1)) {
+            free_rows[n_free++] = b->row_map[y];
+        }
+        else {
+            b->row_map[dst_row] = b->row_map[y];
+            b->row_masks[dst_row] = b->row_masks[y];
+            dst_row++;
+        }
+    }
+
+    // fill the top of the board with the removed rows, emptied
+    for (uint32_t i = 0; i < n_free; i++, dst_row++) {
+        b->row_colors[free_rows[i]] = 0;
+        b->row_map[dst_row] = free_rows[i];
+        b->row_masks[dst_row] = 0;
+    }
+
+    // every column above the removed rows dropped, so the column statistics
+    // are recomputed in one pass over the row masks
+    _board_recompute_cols(b);
+
+    _set_board_changed(b);
+}
+
+
+int board_insert_rows(board_t *b, uint32_t n_rows, row_mask_t tiles,
+        uint32_t tile_color) {
+    int32_t height = b->height;
+    int overflow = 0;
+
+    // storage of the rows pushed off the top, which is reused for the new
+    // rows at the bottom
+    uint8_t free_rows[BOARD_MAX_HEIGHT];
+
+    if (n_rows == 0) {
+        return 0;
+    }
+    if (n_rows > (uint32_t) height) {
+        n_rows = height;
     }
+
+    for (uint32_t i = 0; i < n_rows; i++) {
+        int32_t y = height - n_rows + i;
+
+        free_rows[i] = b->row_map[y];
+        overflow |= (b->row_masks[y] != 0);
+    }
+
+    for (int32_t y = height - 1; y >= (int32_t) n_rows; y--) {
+        b->row_map[y] = b->row_map[y - n_rows];
+        b->row_masks[y] = b->row_masks[y - n_rows];
+    }
+
+    tiles &= b->full_row;
+    for (uint32_t y = 0; y < n_rows; y++) {
+        b->row_map[y] = free_rows[y];
+        b->row_colors[free_rows[y]] = 0;
+        b->row_masks[y] = (tile_color != EMPTY) ? tiles : 0;
+
+        for (uint32_t t = tiles; t != 0; t &= t - 1) {
+            _set_color_idx(b, __builtin_ctz(t), y, tile_color);
+        }
+    }
+
+    // every column was pushed up, so recompute all column statistics
+    _board_recompute_cols(b);
+
+    _set_board_changed(b);
+
+    return overflow;
 }
 
 
@@ -380,17 +693,7 @@ void board_clear_row(board_t *b, int32_t row) {
  * returns 1 if any piece could be placed on the board, otherwise 0
  */
 int board_place_piece(board_t *b, piece_t piece) {
-    define_each_piece_tile(p, piece);
-    uint32_t tile_color = piece.piece_idx;
-
-    int piece_placed = 0;
-
-    piece_placed |= board_set_tile(b, p_x1, p_y1, tile_color);
-    piece_placed |= board_set_tile(b, p_x2, p_y2, tile_color);
-    piece_placed |= board_set_tile(b, p_x3, p_y3, tile_color);
-    piece_placed |= board_set_tile(b, p_x4, p_y4, tile_color);
-
-    return piece_placed;
+    return _board_fill_piece(b, piece, piece.piece_idx);
 }
 
 /*
@@ -398,16 +701,22 @@ int board_place_piece(board_t *b, piece_t piece) {
  * the piece would be on the board), 0 otherwise
  */
 int board_can_place_piece(board_t *b, piece_t piece) {
-    define_each_piece_tile(p, piece);
+    if (_piece_out_of_range(b, piece)) {
+        return 0;
+    }
 
-    int piece_placed = 0;
+    const uint32_t *masks = piece_row_masks(piece);
 
-    piece_placed |= p_y1 < b->height && !board_get_tile(b, p_x1, p_y1);
-    piece_placed |= p_y2 < b->height && !board_get_tile(b, p_x2, p_y2);
-    piece_placed |= p_y3 < b->height && !board_get_tile(b, p_x3, p_y3);
-    piece_placed |= p_y4 < b->height && !board_get_tile(b, p_x4, p_y4);
+    uint32_t free_tiles = 0;
+    for (int32_t r = 0; r < PIECE_BB_H; r++) {
+        int32_t y = piece.board_y + r;
+        if (((uint32_t) y) < b->height) {
+            // tiles of the piece which land on empty tiles of the board
+            free_tiles |= masks[r] & ~_board_row_bits(b, y);
+        }
+    }
 
-    return piece_placed;
+    return free_tiles != 0;
 }
 
 
@@ -416,12 +725,7 @@ int board_can_place_piece(board_t *b, piece_t piece) {
  * to EMPTY
  */
 void board_remove_piece(board_t *b, piece_t piece) {
-    define_each_piece_tile(p, piece);
-
-    board_set_tile(b, p_x1, p_y1, EMPTY);
-    board_set_tile(b, p_x2, p_y2, EMPTY);
-    board_set_tile(b, p_x3, p_y3, EMPTY);
-    board_set_tile(b, p_x4, p_y4, EMPTY);
+    _board_fill_piece(b, piece, EMPTY);
 }
 
 
@@ -431,20 +735,271 @@ void board_remove_piece(board_t *b, piece_t piece) {
  * are already on the given board
  */
 int board_piece_collides(board_t *b, piece_t piece) {
-    define_each_piece_tile(p, piece);
+    if (_piece_out_of_range(b, piece)) {
+        return 1;
+    }
+
+    const uint32_t *masks = piece_row_masks(piece);
 
-    uint8_t p1 = board_get_tile(b, p_x1, p_y1);
-    uint8_t p2 = board_get_tile(b, p_x2, p_y2);
-    uint8_t p3 = board_get_tile(b, p_x3, p_y3);
-    uint8_t p4 = board_get_tile(b, p_x4, p_y4);
+    int32_t y = piece.board_y;
 
-    // if all squares are empty, then all four tiles or-ed together will be
-    // 0, otherwise, if any tile isn't empty, we will get a nonzero result
-    return ((p1 | p2) | (p3 | p4)) != 0;
+    // if all squares are empty, then all four rows and-ed with the board and
+    // or-ed together will be 0, otherwise, if any tile isn't empty, we will
+    // get a nonzero result
+    return ((masks[0] & _board_row_bits(b, y)) |
+            (masks[1] & _board_row_bits(b, y + 1)) |
+            (masks[2] & _board_row_bits(b, y + 2)) |
+            (masks[3] & _board_row_bits(b, y + 3))) != 0;
 }
 
 
 
+int32_t board_landing_row(board_t *b, piece_t piece) {
+    if (_piece_out_of_range(b, piece)) {
+        return piece.board_y;
+    }
+
+    const uint8_t *bottoms = piece_bottom_offsets(piece);
+
+    int32_t land_y = INT32_MIN;
+    int above_surface = 1;
+
+    for (int32_t c = 0; c < PIECE_BB_W; c++) {
+        if (bottoms[c] == PIECE_COL_EMPTY) {
+            continue;
+        }
+
+        int32_t x = piece.board_x + c;
+        if (x < 0 || x >= (int32_t) b->width) {
+            // the piece is inside a wall
+            above_surface = 0;
+            break;
+        }
+
+        int32_t col_height = b->col_heights[x];
+        // the lowest tile in this column lands right on top of the column
+        int32_t col_land_y = col_height - bottoms[c];
+
+        land_y = col_land_y > land_y ? col_land_y : land_y;
+        above_surface &= piece.board_y >= col_land_y;
+    }
+
+    if (above_surface) {
+        return land_y;
+    }
+
+    // some part of the piece is below the top of its column (i.e. tucked
+    // under an overhang), so the surface says nothing about where it stops
+    do {
+        piece.board_y--;
+    } while (!board_piece_collides(b, piece));
+
+    return piece.board_y + 1;
+}
+
+
+
+/*
+ * bitmasks of positions a piece can be at for board_piece_placements, one per
+ * orientation and board_y (offset by PIECE_BB_H), where bit board_x +
+ * PIECE_MASK_OFF is set iff the piece is at that position
+ */
+typedef uint32_t __placement_map[N_PIECE_ORIENTATIONS][BOARD_PLACEMENT_N_Y];
+
+
+/*
+ * moves every position in xs over by dx
+ */
+static uint32_t __shift_xs(uint32_t xs, int8_t dx) {
+    return (dx >= 0) ? (xs << dx) : (xs >> -dx);
+}
+
+
+/*
+ * finds the positions in each orientation and row where the piece fits on the
+ * board, where valid_xs is the set of board_x values pieces can have
+ */
+static void _placement_fits(board_t *b, uint8_t piece_idx, uint32_t valid_xs,
+        __placement_map fits) {
+
+    for (uint8_t o = 0; o < N_PIECE_ORIENTATIONS; o++) {
+        // occupancy of each row of the piece's bounding box, with its left
+        // edge at bit 0
+        const uint32_t * masks = piece_masks[piece_idx - 1][o][PIECE_MASK_OFF];
+
+        for (int32_t yi = 0; yi < (int32_t) b->height + 2 * PIECE_BB_H;
+                yi++) {
+            int32_t y = yi - PIECE_BB_H;
+            uint32_t collides = 0;
+
+            for (int32_t r = 0; r < PIECE_BB_H; r++) {
+                uint32_t row = _board_row_bits(b, y + r);
+
+                // the piece collides at board_x iff some tile in column c of
+                // its bounding box lands on a filled tile at board_x + c
+                for (uint32_t cols = masks[r] >> PIECE_MASK_OFF; cols != 0;
+                        cols &= cols - 1) {
+                    collides |= row >> __builtin_ctz(cols);
+                }
+            }
+
+            fits[o][yi] = ~collides & valid_xs;
+        }
+    }
+}
+
+
+uint32_t board_piece_placements(board_t *b, piece_t piece,
+        piece_t *placements) {
+    __placement_map fits;
+    __placement_map reach;
+
+    int32_t n_y = b->height + 2 * PIECE_BB_H;
+    uint32_t valid_xs = (1U << (b->width + PIECE_MASK_OFF)) - 1;
+
+    // stack of (orientation, row) pairs whose reachable positions have grown
+    // since they were last expanded, with pending marking which are on it
+    uint8_t stack[N_PIECE_ORIENTATIONS * BOARD_PLACEMENT_N_Y];
+    uint32_t n_stack = 0;
+    uint8_t pending[N_PIECE_ORIENTATIONS][BOARD_PLACEMENT_N_Y];
+
+    int32_t yi0 = piece.board_y + PIECE_BB_H;
+    if (_piece_out_of_range(b, piece) || yi0 < 0 || yi0 >= n_y) {
+        return 0;
+    }
+
+    _placement_fits(b, piece.piece_idx, valid_xs, fits);
+
+    uint32_t x0 = 1U << (piece.board_x + PIECE_MASK_OFF);
+    if ((fits[piece.orientation][yi0] & x0) == 0) {
+        return 0;
+    }
+
+    memset(reach, 0, sizeof(reach));
+    memset(pending, 0, sizeof(pending));
+
+#define __REACH(o, yi, xs) \
+    do { \
+        uint32_t __new = (xs) & ~reach[o][yi]; \
+        if (__new != 0) { \
+            reach[o][yi] |= __new; \
+            if (!pending[o][yi]) { \
+                pending[o][yi] = 1; \
+                stack[n_stack++] = (o) * BOARD_PLACEMENT_N_Y + (yi); \
+            } \
+        } \
+    } while (0)
+
+    __REACH(piece.orientation, yi0, x0);
+
+    while (n_stack > 0) {
+        uint32_t top = stack[--n_stack];
+        uint8_t o = top / BOARD_PLACEMENT_N_Y;
+        int32_t yi = top % BOARD_PLACEMENT_N_Y;
+        pending[o][yi] = 0;
+
+        uint32_t fit = fits[o][yi];
+        uint32_t xs = reach[o][yi];
+
+        // slide left and right as far as the piece fits
+        uint32_t prev;
+        do {
+            prev = xs;
+            xs |= ((xs << 1) | (xs >> 1)) & fit;
+        } while (xs != prev);
+        reach[o][yi] = xs;
+
+        // move down
+        if (yi > 0) {
+            __REACH(o, yi - 1, xs & fits[o][yi - 1]);
+        }
+
+        // rotate both ways, where each position goes to the first of its wall
+        // kick trials the piece fits in
+        for (int rot = -1; rot <= 1; rot += 2) {
+            uint8_t new_o = (o + rot) & 0x3;
+            uint32_t left = xs;
+            int8_t dx, dy;
+
+            if (piece.piece_idx == PIECE_O) {
+                // the O piece rotates in place
+                __REACH(new_o, yi, left & fits[new_o][yi]);
+                continue;
+            }
+
+            for_each_displacement_trial(piece.piece_idx, o, rot, dx, dy) {
+                int32_t new_yi = yi + dy;
+                if (new_yi < 0) {
+                    // entirely below the floor, so the trial fails
+                    continue;
+                }
+                if (new_yi >= n_y) {
+                    // the rows above the map are empty, like the top rows
+                    // of the map, so the trial succeeds wherever the piece
+                    // fits in the top row, which it can then fall back to
+                    new_yi = n_y - 1;
+                }
+
+                uint32_t moved = __shift_xs(left, dx) & fits[new_o][new_yi];
+                __REACH(new_o, new_yi, moved);
+
+                // positions which took this trial don't try any more
+                left &= ~__shift_xs(moved, -dx);
+            }
+        }
+    }
+
+#undef __REACH
+
+    // the piece locks wherever it can't move down any farther
+    uint32_t n_placements = 0;
+    for (uint8_t o = 0; o < N_PIECE_ORIENTATIONS; o++) {
+        for (int32_t yi = 0; yi < n_y; yi++) {
+            uint32_t locks = reach[o][yi] &
+                ~(yi > 0 ? fits[o][yi - 1] : 0);
+
+            for (; locks != 0; locks &= locks - 1) {
+                piece_t *p = &placements[n_placements++];
+
+                p->piece_idx = piece.piece_idx;
+                p->orientation = o;
+                p->board_x = __builtin_ctz(locks) - PIECE_MASK_OFF;
+                p->board_y = yi - PIECE_BB_H;
+            }
+        }
+    }
+
+    return n_placements;
+}
+
+
+
+/*
+ * packs the color indices of every tile of the board, row by row from the
+ * bottom up, into color_idxs, which is the layout board.vs expects
+ */
+static void _board_pack_color_idxs(board_t *b, uint32_t *color_idxs) {
+    uint32_t row_bits = b->width * LOG_N_STATES;
+
+    memset(color_idxs, 0,
+            color_idxs_arr_len(b->width * b->height) * sizeof(uint32_t));
+
+    for (uint32_t y = 0; y < b->height; y++) {
+        row_colors_t row = *_board_row_colors(b, y);
+        uint32_t bit = y * row_bits;
+
+        // a row is at most 64 bits, so it spans at most 3 words
+        for (uint32_t n = 0; n < row_bits; ) {
+            uint32_t word = (bit + n) / 32;
+            uint32_t off = (bit + n) % 32;
+
+            color_idxs[word] |= (uint32_t) ((row >> n) << off);
+            n += 32 - off;
+        }
+    }
+}
+
+
 void board_draw(board_t *b) {
     gl_use_program(&b->p);
 
@@ -453,8 +1008,14 @@ void board_draw(board_t *b) {
     TETRIS_ASSERT((b->flags & BOARD_DO_GRAPHICS) != 0);
 
     if (_board_changed(b)) {
-        // send over all color information about tiles
-        glUniform1uiv(b->color_idxs_loc, b->width * b->height, b->color_idxs);
+        // send over all color information about tiles, with the rows put
+        // back in order
+        uint32_t color_idxs[color_idxs_arr_len(BOARD_MAX_WIDTH *
+                BOARD_MAX_HEIGHT)];
+        _board_pack_color_idxs(b, color_idxs);
+
+        glUniform1uiv(b->color_idxs_loc,
+                color_idxs_arr_len(b->width * b->height), color_idxs);
         glUniform1ui(b->grayed_loc, _board_is_grayed(b));
 
         _unset_board_changed(b);
@@ -0,0 +1,121 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <math/random.h>
+
+#include <headless.h>
+#include <tutil.h>
+
+
+void headless_play(uint64_t seed, uint32_t level, uint64_t max_ticks,
+        int (*go)(void *agent, tetris_state *s), void *agent,
+        struct headless_result *res) {
+    tetris_state s;
+
+    seed_rand(seed, 0);
+
+    tetris_state_init(&s);
+    tetris_set_level(&s, level);
+    tetris_get_next_falling_piece_transient(&s);
+
+    while (!tetris_game_is_over(&s) && s.time < max_ticks) {
+        tetris_state_step_transient(&s);
+        go(agent, &s);
+        tetris_tick(&s);
+    }
+
+    res->score = s.scorer.score;
+    res->lines = s.scorer.cleared_lines;
+    res->level = s.scorer.level;
+    res->pieces = s.n_pieces;
+    res->ticks = s.time;
+    res->over = tetris_game_is_over(&s);
+
+    tetris_state_destroy(&s);
+}
+
+
+
+struct headless_pool {
+    void (*job)(void *arg, uint32_t i);
+    void *arg;
+    uint32_t n_jobs;
+    // index of the next job to be taken
+    _Atomic uint32_t next;
+};
+
+
+static void * _worker(void *arg) {
+    struct headless_pool *pool = (struct headless_pool *) arg;
+
+    for (;;) {
+        uint32_t i = atomic_fetch_add(&pool->next, 1);
+        if (i >= pool->n_jobs) {
+            break;
+        }
+        pool->job(pool->arg, i);
+    }
+    return NULL;
+}
+
+
+void headless_run_jobs(uint32_t n_jobs, uint32_t n_threads,
+        void (*job)(void *arg, uint32_t i), void *arg) {
+    struct headless_pool pool = {
+        .job = job,
+        .arg = arg,
+        .n_jobs = n_jobs
+    };
+    atomic_init(&pool.next, 0);
+
+    pthread_t *threads = (pthread_t *) malloc(n_threads * sizeof(pthread_t));
+    TETRIS_ASSERT(threads != NULL);
+
+    for (uint32_t i = 0; i < n_threads; i++) {
+        int res = pthread_create(&threads[i], NULL, &_worker, &pool);
+        TETRIS_ASSERT(res == 0);
+    }
+    for (uint32_t i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+}
+
+
+
+int headless_parse_u64(const char *arg, uint64_t max, uint64_t *res) {
+    char *end;
+
+    // strtoull skips leading whitespace and negates numbers with a leading
+    // '-', so only let it see numbers which start with a digit
+    if (*arg < '0' || *arg > '9') {
+        fprintf(stderr, "%s is not a valid base 10 unsigned number\n", arg);
+        return -1;
+    }
+
+    errno = 0;
+    unsigned long long val = strtoull(arg, &end, 10);
+    if (*end != '\0') {
+        fprintf(stderr, "%s is not a valid base 10 unsigned number\n", arg);
+        return -1;
+    }
+    if (errno == ERANGE || val > max) {
+        fprintf(stderr, "%s is more than the max of %llu\n", arg,
+                (unsigned long long) max);
+        return -1;
+    }
+
+    *res = val;
+    return 0;
+}
+
+
+int headless_usage(const char *prog, const char *opts) {
+    fprintf(stderr, "Usage: %s %s\n", prog, opts);
+    return -1;
+}
+
@@ -11,6 +11,7 @@
 
 #include <game.h>
 #include <ai.h>
+#include <headless.h>
 
 #include <syslog.h>
 #include <util.h>
@@ -53,15 +54,16 @@ int main(int argc, char *argv[]) {
     char *buf;
 
     // by default don't use an AI
-    struct ai *ai = NULL;
+    const struct ai *ai_type = NULL;
+    struct ai ai;
 
     int opt;
     while ((opt = getopt(argc, argv, "p:a:s:l:q")) != -1) {
         switch(opt) {
             case 'a':
                 // use AI
-                ai = fetch_ai(optarg);
-                if (ai == NULL) {
+                ai_type = fetch_ai(optarg);
+                if (ai_type == NULL) {
                     fprintf(stderr, "%s is not a builtin AI name\n", optarg);
                     return -1;
                 }
@@ -121,9 +123,12 @@ int main(int argc, char *argv[]) {
         game_flags = SHOW_ALL;
     }
 
-    if (ai != NULL) {
+    if (ai_type != NULL) {
         game_init(&g, game_flags | MANUAL_CONTROL, (quiet ? NULL : &c), &font);
-        ai_init(ai, &g);
+        // quiet games search to full depth every move, so that they play out
+        // the same way every time for a given seed
+        ai_init(&ai, ai_type, quiet ? 0 : AI_LIVE);
+        game_set_ctrl_callback(&g, &ai_ctrl_callback, (void*) &ai);
     }
     else {
         if (quiet) {
@@ -139,7 +144,7 @@ int main(int argc, char *argv[]) {
             (!quiet && !gl_should_exit(&c))) {
         game_tick(&g);
 
-        if (g.t.game_state.time >= 500000) {
+        if (g.t.game_state.time >= HEADLESS_DEFAULT_MAX_TICKS) {
             print_board(&g.t.game_state);
             break;
         }
@@ -152,8 +157,8 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if (ai != NULL) {
-        ai_destroy(ai);
+    if (ai_type != NULL) {
+        ai_destroy(&ai);
     }
 
     game_destroy(&g);
@@ -5,6 +5,47 @@
 #include <piece.h>
 
 
+/*
+ * layout bitvectors of each piece in each orientation (pictured in pieces
+ * below). These are macros so that piece_masks can be built from them at
+ * compile time
+ */
+#define I_LAYOUT_0 0xba98
+#define I_LAYOUT_1 0xea62
+#define I_LAYOUT_2 0x7654
+#define I_LAYOUT_3 0xd951
+
+#define S_LAYOUT_0 0xa954
+#define S_LAYOUT_1 0x9652
+#define S_LAYOUT_2 0x6510
+#define S_LAYOUT_3 0x8541
+
+#define J_LAYOUT_0 0x8654
+#define J_LAYOUT_1 0xa951
+#define J_LAYOUT_2 0x6542
+#define J_LAYOUT_3 0x9510
+
+#define T_LAYOUT_0 0x9654
+#define T_LAYOUT_1 0x9651
+#define T_LAYOUT_2 0x6541
+#define T_LAYOUT_3 0x9541
+
+#define L_LAYOUT_0 0xa654
+#define L_LAYOUT_1 0x9521
+#define L_LAYOUT_2 0x6540
+#define L_LAYOUT_3 0x9851
+
+#define Z_LAYOUT_0 0x9865
+#define Z_LAYOUT_1 0xa651
+#define Z_LAYOUT_2 0x5421
+#define Z_LAYOUT_3 0x9540
+
+#define O_LAYOUT_0 0xa965
+#define O_LAYOUT_1 0xa965
+#define O_LAYOUT_2 0xa965
+#define O_LAYOUT_3 0xa965
+
+
 const struct piece_layout pieces[N_PIECES] = {
     // I tetromino
     {
@@ -17,7 +58,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 2), (1, 2), (2, 2), (3, 2)
              */
-            0xba98,
+            I_LAYOUT_0,
             /*
              * . . O .
              * . . O .
@@ -26,7 +67,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (2, 0), (2, 1), (2, 2), (2, 3)
              */
-            0xea62,
+            I_LAYOUT_1,
             /*
              * . . . .
              * . . . .
@@ -35,7 +76,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 1), (1, 1), (2, 1), (3, 1)
              */
-            0x7654,
+            I_LAYOUT_2,
             /*
              * . O . .
              * . O . .
@@ -44,7 +85,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (1, 1), (1, 2), (1, 3)
              */
-            0xd951
+            I_LAYOUT_3
         }
     },
     // S tetromino
@@ -57,7 +98,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 1), (1, 1), (1, 2), (2, 2)
              */
-            0xa954,
+            S_LAYOUT_0,
             /*
              * . O .
              * . O O
@@ -65,7 +106,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (2, 0), (1, 1), (2, 1), (1, 2)
              */
-            0x9652,
+            S_LAYOUT_1,
             /*
              * . . .
              * . O O
@@ -73,7 +114,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 0), (1, 0), (1, 1), (2, 1)
              */
-            0x6510,
+            S_LAYOUT_2,
             /*
              * O . .
              * O O .
@@ -81,7 +122,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (0, 1), (1, 1), (0, 2)
              */
-            0x8541
+            S_LAYOUT_3
         }
     },
     // J tetromino
@@ -94,7 +135,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 1), (1, 1), (2, 1), (0, 2)
              */
-            0x8654,
+            J_LAYOUT_0,
             /*
              * . O O
              * . O .
@@ -102,7 +143,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (1, 1), (1, 2), (2, 2)
              */
-            0xa951,
+            J_LAYOUT_1,
             /*
              * . . .
              * O O O
@@ -110,7 +151,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (2, 0), (0, 1), (1, 1), (2, 1)
              */
-            0x6542,
+            J_LAYOUT_2,
             /*
              * . O .
              * . O .
@@ -118,7 +159,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 0), (1, 0), (1, 1), (1, 2)
              */
-            0x9510
+            J_LAYOUT_3
         }
     },
     // T tetromino
@@ -131,7 +172,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 1), (1, 1), (2, 1), (1, 2)
              */
-            0x9654,
+            T_LAYOUT_0,
             /*
              * . O .
              * . O O
@@ -139,7 +180,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (1, 1), (2, 1), (1, 2)
              */
-            0x9651,
+            T_LAYOUT_1,
             /*
              * . . .
              * O O O
@@ -147,7 +188,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (0, 1), (1, 1), (2, 1)
              */
-            0x6541,
+            T_LAYOUT_2,
             /*
              * . O .
              * O O .
@@ -155,7 +196,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (0, 1), (1, 1), (1, 2)
              */
-            0x9541
+            T_LAYOUT_3
         }
     },
     // L tetromino
@@ -168,7 +209,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 1), (1, 1), (2, 1), (2, 2)
              */
-            0xa654,
+            L_LAYOUT_0,
             /*
              * . O .
              * . O .
@@ -176,7 +217,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (2, 0), (1, 1), (1, 2)
              */
-            0x9521,
+            L_LAYOUT_1,
             /*
              * . . .
              * O O O
@@ -184,7 +225,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 0), (0, 1), (1, 1), (2, 1)
              */
-            0x6540,
+            L_LAYOUT_2,
             /*
              * O O .
              * . O .
@@ -192,7 +233,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (1, 1), (0, 2), (1, 2)
              */
-            0x9851
+            L_LAYOUT_3
         }
     },
     // Z tetromino
@@ -205,7 +246,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 1), (2, 1), (0, 2), (1, 2)
              */
-            0x9865,
+            Z_LAYOUT_0,
             /*
              * . . O
              * . O O
@@ -213,7 +254,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (1, 1), (2, 1), (2, 2)
              */
-            0xa651,
+            Z_LAYOUT_1,
             /*
              * . . .
              * O O .
@@ -221,7 +262,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 0), (2, 0), (0, 1), (1, 1)
              */
-            0x5421,
+            Z_LAYOUT_2,
             /*
              * . O .
              * O O .
@@ -229,7 +270,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (0, 0), (0, 1), (1, 1), (1, 2)
              */
-            0x9540
+            Z_LAYOUT_3
         }
     },
     // O tetromino
@@ -242,7 +283,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 1), (2, 1), (1, 2), (2, 2)
              */
-            0xa965,
+            O_LAYOUT_0,
             /*
              * . O O .
              * . O O .
@@ -250,7 +291,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 1), (2, 1), (1, 2), (2, 2)
              */
-            0xa965,
+            O_LAYOUT_1,
             /*
              * . O O .
              * . O O .
@@ -258,7 +299,7 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 1), (2, 1), (1, 2), (2, 2)
              */
-            0xa965,
+            O_LAYOUT_2,
             /*
              * . O O .
              * . O O .
@@ -266,13 +307,115 @@ const struct piece_layout pieces[N_PIECES] = {
              *
              * (1, 1), (2, 1), (1, 2), (2, 2)
              */
-            0xa965
+            O_LAYOUT_3
         }
     }
 };
 
 
 
+/*
+ * bit of row r of the given layout contributed by the i-th tile of the layout,
+ * with tile column 0 at bit "shift"
+ */
+#define __LAYOUT_TILE_BIT(layout, i, r, shift) \
+    ((((layout) >> (4 * (i) + 2)) & 0x3) == (r) ? \
+        1U << ((((layout) >> (4 * (i))) & 0x3) + (shift)) : 0U)
+
+#define __LAYOUT_ROW(layout, r, shift) \
+    (__LAYOUT_TILE_BIT(layout, 0, r, shift) | \
+     __LAYOUT_TILE_BIT(layout, 1, r, shift) | \
+     __LAYOUT_TILE_BIT(layout, 2, r, shift) | \
+     __LAYOUT_TILE_BIT(layout, 3, r, shift))
+
+#define __LAYOUT_ROWS(layout, shift) \
+    { \
+        __LAYOUT_ROW(layout, 0, shift), \
+        __LAYOUT_ROW(layout, 1, shift), \
+        __LAYOUT_ROW(layout, 2, shift), \
+        __LAYOUT_ROW(layout, 3, shift) \
+    }
+
+// one set of rows per x offset, must be PIECE_MASK_N_X of them
+#define __LAYOUT_SHIFTS(layout) \
+    { \
+        __LAYOUT_ROWS(layout,  0), __LAYOUT_ROWS(layout,  1), \
+        __LAYOUT_ROWS(layout,  2), __LAYOUT_ROWS(layout,  3), \
+        __LAYOUT_ROWS(layout,  4), __LAYOUT_ROWS(layout,  5), \
+        __LAYOUT_ROWS(layout,  6), __LAYOUT_ROWS(layout,  7), \
+        __LAYOUT_ROWS(layout,  8), __LAYOUT_ROWS(layout,  9), \
+        __LAYOUT_ROWS(layout, 10), __LAYOUT_ROWS(layout, 11), \
+        __LAYOUT_ROWS(layout, 12), __LAYOUT_ROWS(layout, 13), \
+        __LAYOUT_ROWS(layout, 14), __LAYOUT_ROWS(layout, 15), \
+        __LAYOUT_ROWS(layout, 16), __LAYOUT_ROWS(layout, 17), \
+        __LAYOUT_ROWS(layout, 18), __LAYOUT_ROWS(layout, 19) \
+    }
+
+#define __PIECE_MASKS(name) \
+    { \
+        __LAYOUT_SHIFTS(name ## _LAYOUT_0), \
+        __LAYOUT_SHIFTS(name ## _LAYOUT_1), \
+        __LAYOUT_SHIFTS(name ## _LAYOUT_2), \
+        __LAYOUT_SHIFTS(name ## _LAYOUT_3) \
+    }
+
+
+const uint32_t __attribute__((aligned(16))) piece_masks[N_PIECES]
+        [N_PIECE_ORIENTATIONS][PIECE_MASK_N_X][PIECE_BB_H] = {
+    __PIECE_MASKS(I),
+    __PIECE_MASKS(S),
+    __PIECE_MASKS(J),
+    __PIECE_MASKS(T),
+    __PIECE_MASKS(L),
+    __PIECE_MASKS(Z),
+    __PIECE_MASKS(O)
+};
+
+
+/*
+ * row of the i-th tile of the given layout if that tile is in column c,
+ * otherwise PIECE_COL_EMPTY
+ */
+#define __LAYOUT_TILE_Y(layout, i, c) \
+    ((((layout) >> (4 * (i))) & 0x3) == (c) ? \
+        (((layout) >> (4 * (i) + 2)) & 0x3) : PIECE_COL_EMPTY)
+
+#define __MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define __LAYOUT_COL_BOTTOM(layout, c) \
+    __MIN(__MIN(__LAYOUT_TILE_Y(layout, 0, c), __LAYOUT_TILE_Y(layout, 1, c)), \
+          __MIN(__LAYOUT_TILE_Y(layout, 2, c), __LAYOUT_TILE_Y(layout, 3, c)))
+
+#define __LAYOUT_COL_BOTTOMS(layout) \
+    { \
+        __LAYOUT_COL_BOTTOM(layout, 0), \
+        __LAYOUT_COL_BOTTOM(layout, 1), \
+        __LAYOUT_COL_BOTTOM(layout, 2), \
+        __LAYOUT_COL_BOTTOM(layout, 3) \
+    }
+
+#define __PIECE_COL_BOTTOMS(name) \
+    { \
+        __LAYOUT_COL_BOTTOMS(name ## _LAYOUT_0), \
+        __LAYOUT_COL_BOTTOMS(name ## _LAYOUT_1), \
+        __LAYOUT_COL_BOTTOMS(name ## _LAYOUT_2), \
+        __LAYOUT_COL_BOTTOMS(name ## _LAYOUT_3) \
+    }
+
+
+const uint8_t piece_col_bottoms[N_PIECES][N_PIECE_ORIENTATIONS]
+        [PIECE_BB_W] = {
+    __PIECE_COL_BOTTOMS(I),
+    __PIECE_COL_BOTTOMS(S),
+    __PIECE_COL_BOTTOMS(J),
+    __PIECE_COL_BOTTOMS(T),
+    __PIECE_COL_BOTTOMS(L),
+    __PIECE_COL_BOTTOMS(Z),
+    __PIECE_COL_BOTTOMS(O)
+};
+
+
+
 /*
  * encodes the 5 displacement trials to be done on a tile which was rotated for
  * J, L, S, T, and Z tetrominoes
@@ -300,44 +443,25 @@ const struct piece_layout pieces[N_PIECES] = {
  *     -1 as 0111 = 0x7
  *     -2 as 0110 = 0x6
  *
- * each number is given an extra bit of padding so they can all be added
- * together with a single 32-bit integer addition
- *
- * to negate all of the numbers, we have to bitwise invert, mask off the
- * padding bits which were set by the inversion, then add 1 to each of the
- * numbers, which looks like
- *
- *  pad_mask = 0x77777;
- *  neg_row = (~row & pad_mask) + 0x11111;
- *  res_row = pos_row + neg_row
- *
- * the addition that will be done next is guaranteed not to overflow because
- * the max value of two numbers which will ever be added is -1 (0x7) and -0
- * (~0x0 + 1 = 0x8), which sum to 0xf exactly
- *
- *
+ * each number is given an extra bit of padding, and the rows are decoded and
+ * subtracted at compile time into piece_kicks below, so none of this is done
+ * while rotating
  */
-const uint32_t displacement_trial_data[8] = {
-    // orientation 0, x
-    0x00000,
-    // orientation 0, y
-    0x00000,
-
-    // orientation 1, x
-    0x10110,
-    // orientation 1, y
-    0x22700,
-
-    // orientation 2, x
-    0x00000,
-    // orientation 2, y
-    0x00000,
-
-    // orientation 3, x
-    0x70770,
-    // orientation 3, y
-    0x22700,
-};
+// orientation 0
+#define __TRIALS_X_0 0x00000
+#define __TRIALS_Y_0 0x00000
+
+// orientation 1
+#define __TRIALS_X_1 0x10110
+#define __TRIALS_Y_1 0x22700
+
+// orientation 2
+#define __TRIALS_X_2 0x00000
+#define __TRIALS_Y_2 0x00000
+
+// orientation 3
+#define __TRIALS_X_3 0x70770
+#define __TRIALS_Y_3 0x22700
 
 
 
@@ -357,50 +481,96 @@ const uint32_t displacement_trial_data[8] = {
  *  L->0 ( 0, 0) (-2, 0) (+1, 0) (-2,+1) (+1,-2)
  *  0->L ( 0, 0) (+2, 0) (-1, 0) (-1,+2) (+2,-1)
  *
- * the rotation data layout is the same as above, except now all 8 orientation-
+ * the rotation data encoding is the same as above, except now all 8 orientation-
  * rotation pairs are laid out explicitly (since there is no way to do what we
  * did above for this tile, with the changes from Arika SRS)
  */
-const uint32_t displacement_trial_data_I[16] = {
-    // 0 -> L (x)
-    0x27720,
-    //        (y)
-    0x72000,
-
-    // 0 -> R (x)
-    0x61160,
-    //        (y)
-    0x72000,
-
-    // R -> 0 (x)
-    0x72720,
-    //        (y)
-    0x61000,
-
-    // R -> 2 (x)
-    0x27270,
-    //        (y)
-    0x72000,
-
-    // 2 -> R (x)
-    0x16160,
-    //        (y)
-    0x71000,
-
-    // 2 -> L (x)
-    0x72720,
-    //        (y)
-    0x71000,
-
-    // L -> 2 (x)
-    0x61610,
-    //        (y)
-    0x72000,
-
-    // L -> 0 (x)
-    0x16160,
-    //        (y)
-    0x61000,
+// 0 -> L
+#define __TRIALS_I_X_0_CCW 0x27720
+#define __TRIALS_I_Y_0_CCW 0x72000
+
+// 0 -> R
+#define __TRIALS_I_X_0_CW  0x61160
+#define __TRIALS_I_Y_0_CW  0x72000
+
+// R -> 0
+#define __TRIALS_I_X_1_CCW 0x72720
+#define __TRIALS_I_Y_1_CCW 0x61000
+
+// R -> 2
+#define __TRIALS_I_X_1_CW  0x27270
+#define __TRIALS_I_Y_1_CW  0x72000
+
+// 2 -> R
+#define __TRIALS_I_X_2_CCW 0x16160
+#define __TRIALS_I_Y_2_CCW 0x71000
+
+// 2 -> L
+#define __TRIALS_I_X_2_CW  0x72720
+#define __TRIALS_I_Y_2_CW  0x71000
+
+// L -> 2
+#define __TRIALS_I_X_3_CCW 0x61610
+#define __TRIALS_I_Y_3_CCW 0x72000
+
+// L -> 0
+#define __TRIALS_I_X_3_CW  0x16160
+#define __TRIALS_I_Y_3_CW  0x61000
+
+
+
+/*
+ * i-th number (trial i + 1) of a row of displacement trial data, sign
+ * extended from 3 bits
+ */
+#define __TRIAL(row, i) \
+    ((int8_t) (((((row) >> (4 * (i))) & 0x7) ^ 0x4) - 0x4))
+
+#define __TRIALS(x_row, y_row) \
+    { \
+        { __TRIAL(x_row, 0), __TRIAL(y_row, 0) }, \
+        { __TRIAL(x_row, 1), __TRIAL(y_row, 1) }, \
+        { __TRIAL(x_row, 2), __TRIAL(y_row, 2) }, \
+        { __TRIAL(x_row, 3), __TRIAL(y_row, 3) }, \
+        { __TRIAL(x_row, 4), __TRIAL(y_row, 4) } \
+    }
+
+// element-wise difference of the rows of orientations from and to
+#define __DIFF_TRIAL(from, to, i) \
+    { \
+        __TRIAL(__TRIALS_X_ ## from, i) - __TRIAL(__TRIALS_X_ ## to, i), \
+        __TRIAL(__TRIALS_Y_ ## from, i) - __TRIAL(__TRIALS_Y_ ## to, i) \
+    }
+
+#define __DIFF_TRIALS(from, to) \
+    { \
+        __DIFF_TRIAL(from, to, 0), \
+        __DIFF_TRIAL(from, to, 1), \
+        __DIFF_TRIAL(from, to, 2), \
+        __DIFF_TRIAL(from, to, 3), \
+        __DIFF_TRIAL(from, to, 4) \
+    }
+
+#define __I_TRIALS(from, dir) \
+    __TRIALS(__TRIALS_I_X_ ## from ## _ ## dir, __TRIALS_I_Y_ ## from ## _ ## dir)
+
+
+const piece_kick_t piece_kicks[N_KICK_CLASSES][N_PIECE_ORIENTATIONS]
+        [N_ROTATE_DIRS][N_KICK_TRIALS] = {
+    // J, L, S, T, and Z
+    {
+        { __DIFF_TRIALS(0, 3), __DIFF_TRIALS(0, 1) },
+        { __DIFF_TRIALS(1, 0), __DIFF_TRIALS(1, 2) },
+        { __DIFF_TRIALS(2, 1), __DIFF_TRIALS(2, 3) },
+        { __DIFF_TRIALS(3, 2), __DIFF_TRIALS(3, 0) }
+    },
+    // I
+    {
+        { __I_TRIALS(0, CCW), __I_TRIALS(0, CW) },
+        { __I_TRIALS(1, CCW), __I_TRIALS(1, CW) },
+        { __I_TRIALS(2, CCW), __I_TRIALS(2, CW) },
+        { __I_TRIALS(3, CCW), __I_TRIALS(3, CW) }
+    }
 };
 
 
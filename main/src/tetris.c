@@ -94,33 +94,9 @@ static int _clear_animation_done(tetris_t *t) {
 static void _finish_clear_animation(tetris_t *t) {
     clear_animator *c_anim = &t->c_anim;
 
-    int8_t row = canim_get_start_row(c_anim);
-    int8_t dst_row = row;
-
-    // topple down all rows that 
-    for (int i = 0; i < PIECE_BB_H; i++) {
-
-        if (!canim_is_row_idx_set(c_anim, i)) {
-            // if this row is not set, then we have to move it down
-            if (dst_row != row) {
-                // if the current row is not empty and dst_row has already been
-                // offset from row, we need to topple row down to dst_row
-                board_copy_row(&t->game_state.board, dst_row, row);
-            }
-
-            dst_row++;
-        }
-        row++;
-    }
-    // topple down remaining rows
-    for (; row < t->game_state.board.height; row++, dst_row++) {
-        board_copy_row(&t->game_state.board, dst_row, row);
-    }
-
-    // clear the top most rows which were already toppled but not overwritten
-    for (; dst_row < t->game_state.board.height; dst_row++) {
-        board_clear_row(&t->game_state.board, dst_row);
-    }
+    // remove all of the cleared rows and topple down the rows above them
+    board_remove_rows(&t->game_state.board, canim_get_start_row(c_anim),
+            canim_any_rows_set(c_anim));
 
     // now may resume the game
     _switch_state(t, PLAY);
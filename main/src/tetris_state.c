@@ -33,6 +33,31 @@ int tetris_piece_is_sticking(tetris_state *s) {
     return (s->fp_data.falling_status & STICK_NOW) != 0;
 }
 
+static int _pose_is_sticking(const tetris_pose *pose) {
+    return (pose->fp_data.falling_status & STICK_NOW) != 0;
+}
+
+
+void tetris_pose_get(tetris_pose *pose, const tetris_state *s) {
+    pose->time = s->time;
+    pose->major_tick_time = s->major_tick_time;
+    pose->key_callback_time = s->key_callback_time;
+    pose->falling_piece = s->falling_piece;
+    pose->fp_data = s->fp_data;
+    pose->state = s->state;
+    pose->scorer_status = s->scorer.status;
+}
+
+void tetris_pose_set(tetris_state *s, const tetris_pose *pose) {
+    s->time = pose->time;
+    s->major_tick_time = pose->major_tick_time;
+    s->key_callback_time = pose->key_callback_time;
+    s->falling_piece = pose->falling_piece;
+    s->fp_data = pose->fp_data;
+    s->state = pose->state;
+    s->scorer.status = pose->scorer_status;
+}
+
 
 static void _init_piece_hold(piece_hold *p) {
     __builtin_memset(p, 0, sizeof(piece_hold));
@@ -46,7 +71,7 @@ static void _init_scorer(scorer_t *s) {
 }
 
 
-static float _level_drop_rate(uint32_t level) {
+static uint32_t _level_drop_rate(uint32_t level) {
     if (level < 9) {
         return 48 - 5 * level;
     }
@@ -230,16 +255,18 @@ static void _tetris_state_init(tetris_state *state, int flags) {
 
     // initialize time to 0
     state->time = 0LU;
+    state->n_pieces = 0;
 
-    float init_drop_rate = _level_drop_rate(state->scorer.level);
+    uint32_t init_drop_rate = _level_drop_rate(state->scorer.level);
 
     // to make set falling speed happy
-    state->major_tick_count = 1.f;
-    state->major_tick_time  = 0.f;
+    state->tick_den = 1;
+    state->major_tick_count = 1;
+    state->major_tick_time  = 0;
     tetris_set_falling_speed(state, init_drop_rate);
 
     state->key_callback_count = DEFAULT_HELD_KEY_PERIOD;
-    state->key_callback_time  = 0.f;
+    state->key_callback_time  = 0;
 
 }
 
@@ -286,6 +313,24 @@ int tetris_state_is_transient(tetris_state *state) {
 }
 
 
+uint64_t tetris_state_hash(tetris_state *state) {
+    piece_t fp = state->falling_piece;
+
+    // pack everything besides the board into one word. It is inverted before
+    // mixing so that it can never collide with the input of a row key
+    uint64_t extra =
+        ((uint64_t) fp.piece_idx) |
+        (((uint64_t) fp.orientation) << 8) |
+        (((uint64_t) (uint8_t) fp.board_x) << 16) |
+        (((uint64_t) (uint8_t) fp.board_y) << 24) |
+        (((uint64_t) state->hold.piece_idx) << 32) |
+        (((uint64_t) (state->hold.flags & PIECE_HOLD_STALE)) << 40) |
+        (((uint64_t) state->queue_idx) << 48);
+
+    return board_hash(&state->board) ^ tetris_hash_mix(~extra);
+}
+
+
 void tetris_place_falling_piece(tetris_state *state) {
     board_place_piece(&state->board, state->falling_piece);
 }
@@ -300,22 +345,29 @@ int tetris_game_is_over(tetris_state *state) {
 }
 
 
-void tetris_set_falling_speed(tetris_state *s, double period) {
-    double prev_period = s->major_tick_count;
-    // set time to same percentage of the way through current tick as before
-    s->major_tick_time *= period / prev_period;
-    s->major_tick_count = period;
+void tetris_set_falling_speed(tetris_state *s, uint32_t period) {
+    // number of minor time steps per major time step
+    uint32_t divisor;
 
     if (period <= DESIRED_MINOR_TICK_SPEED * 2) {
-        s->minor_tick_count = period / 2;
+        divisor = 2;
     }
     else {
-        uint32_t divisor =
-            (uint32_t) roundf(period / DESIRED_MINOR_TICK_SPEED);
-        TETRIS_ASSERT(divisor != 0);
-        s->minor_tick_count = period / divisor;
+        // period / DESIRED_MINOR_TICK_SPEED, rounded to the nearest integer
+        divisor = (2 * period + DESIRED_MINOR_TICK_SPEED) /
+            (2 * DESIRED_MINOR_TICK_SPEED);
     }
 
+    // with units of 1 / divisor frames, a minor time step is period units
+    uint32_t major_tick_count = period * divisor;
+
+    // set time to same percentage of the way through current tick as before
+    s->major_tick_time = (int32_t) (((int64_t) s->major_tick_time) *
+            major_tick_count / s->major_tick_count);
+
+    s->tick_den = divisor;
+    s->major_tick_count = major_tick_count;
+    s->minor_tick_count = period;
 }
 
 
@@ -347,6 +399,7 @@ static uint32_t _fetch_next_piece_idx(tetris_state *state) {
     // take the next piece from the queue
     next = piece_queue[queue_idx];
     queue_idx++;
+    state->n_pieces++;
 
     if (queue_idx == N_PIECES) {
         // if we just grabbed the last piece in a group of 7, move
@@ -359,8 +412,10 @@ static uint32_t _fetch_next_piece_idx(tetris_state *state) {
         for (uint32_t i = N_PIECES; i < 2 * N_PIECES; i++) {
             piece_queue[i] = (i % N_PIECES) + 1;
         }
-        permute(&piece_queue[N_PIECES], N_PIECES,
-                sizeof(piece_queue[0]));
+        if (!(state->flags & LOOKAHEAD_STATE)) {
+            permute(&piece_queue[N_PIECES], N_PIECES,
+                    sizeof(piece_queue[0]));
+        }
 
         // reset queue index to reflect where the pieces moved
         queue_idx = 0;
@@ -427,16 +482,26 @@ int tetris_move_piece(tetris_state *state, int dx, int dy) {
 
 
 int tetris_move_piece_transient(tetris_state *state, int dx, int dy) {
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, state);
+    int ret = tetris_pose_move(state, &pose, dx, dy);
+    tetris_pose_set(state, &pose);
+
+    return ret;
+}
+
+int tetris_pose_move(tetris_state *state, tetris_pose *pose, int dx, int dy) {
 
     piece_t falling;
     piece_t new_falling;
 
-    if (tetris_piece_is_sticking(state)) {
+    if (_pose_is_sticking(pose)) {
         // if the falling piece is sticking, disable all movement options
         return 0;
     }
 
-    falling = state->falling_piece;
+    falling = pose->falling_piece;
 
     // and now advance the piece to wherever it needs to go
     new_falling = falling;
@@ -450,10 +515,10 @@ int tetris_move_piece_transient(tetris_state *state, int dx, int dy) {
     else {
 
         // otherwise, the piece can now be moved down into the new location
-        state->falling_piece = new_falling;
+        pose->falling_piece = new_falling;
 
         // update last move type in scorer
-        state->scorer.status &= ~SCORER_LAST_ACTION_WAS_ROTATE;
+        pose->scorer_status &= ~SCORER_LAST_ACTION_WAS_ROTATE;
         return 1;
     }
 
@@ -495,18 +560,28 @@ int tetris_rotate_piece(tetris_state *state, int rotation,
 
 int tetris_rotate_piece_transient(tetris_state *state, int rotation,
         int allow_wall_kicks) {
+    tetris_pose pose;
 
+    tetris_pose_get(&pose, state);
+    int ret = tetris_pose_rotate(state, &pose, rotation, allow_wall_kicks);
+    tetris_pose_set(state, &pose);
+
+    return ret;
+}
+
+int tetris_pose_rotate(tetris_state *state, tetris_pose *pose, int rotation,
+        int allow_wall_kicks) {
 
     piece_t falling;
     piece_t new_falling;
     int8_t dx, dy;
 
-    if (tetris_piece_is_sticking(state)) {
+    if (_pose_is_sticking(pose)) {
         // if the falling piece is sticking, disable all movement options
         return 0;
     }
 
-    falling = state->falling_piece;
+    falling = pose->falling_piece;
 
     // and now advance the piece to wherever it needs to go
     new_falling = falling;
@@ -519,10 +594,10 @@ int tetris_rotate_piece_transient(tetris_state *state, int rotation,
 
         // check to see if there would be any collisions here
         if (!board_piece_collides(&state->board, new_falling)) {
-            state->falling_piece = new_falling;
+            pose->falling_piece = new_falling;
 
             // update last action in scorer
-            state->scorer.status |= SCORER_LAST_ACTION_WAS_ROTATE;
+            pose->scorer_status |= SCORER_LAST_ACTION_WAS_ROTATE;
             return 1;
         }
     }
@@ -530,20 +605,18 @@ int tetris_rotate_piece_transient(tetris_state *state, int rotation,
         for_each_displacement_trial(falling.piece_idx, falling.orientation,
                 rotation, dx, dy) {
 
-            piece_move(&new_falling, dx, dy);
+            piece_t kicked = new_falling;
+            piece_move(&kicked, dx, dy);
 
             // check to see if there would be any collisions here
-            if (!board_piece_collides(&state->board, new_falling)) {
+            if (!board_piece_collides(&state->board, kicked)) {
                 // the piece can now be moved down into the new location
-                state->falling_piece = new_falling;
+                pose->falling_piece = kicked;
 
                 // update last action in scorer
-                state->scorer.status |= SCORER_LAST_ACTION_WAS_ROTATE;
+                pose->scorer_status |= SCORER_LAST_ACTION_WAS_ROTATE;
                 return 1;
             }
-
-            // move it back before next iteration
-            piece_move(&new_falling, -dx, -dy);
         }
     }
 
@@ -632,14 +705,8 @@ void tetris_hard_drop(tetris_state *state) {
  * board, and does not place the new falling piece on the board
  */
 void tetris_hard_drop_transient(tetris_state *state) {
-    piece_t fp = state->falling_piece;
-
-    while (!board_piece_collides(&state->board, fp)) {
-        fp.board_y--;
-    }
-    fp.board_y++;
-
-    state->falling_piece = fp;
+    state->falling_piece.board_y =
+        board_landing_row(&state->board, state->falling_piece);
 
     // make the piece stick on the next major time step and disable any other
     // player inputs from moving the piece
@@ -656,35 +723,20 @@ int tetris_clear_lines(tetris_state *state) {
     int32_t top = MIN(state->falling_piece.board_y + PIECE_BB_H,
             state->board.height);
 
-    int32_t r, dst_r;
+    // bitvector of the full rows, with bit i being row bot + i
+    uint32_t full_rows = 0;
 
     int32_t num_rows_cleared = 0;
 
-    for (r = bot, dst_r = bot; r < top;) {
+    for (int32_t r = bot; r < top; r++) {
         if (board_row_full(&state->board, r)) {
+            full_rows |= 1U << (r - bot);
             num_rows_cleared++;
         }
-        else {
-            dst_r++;
-        }
-        r++;
-
-        if (dst_r != r) {
-            board_copy_row(&state->board, dst_r, r);
-        }
     }
 
     if (num_rows_cleared > 0) {
-        // topple down remaining rows
-        for (; r < state->board.height; r++, dst_r++) {
-            board_copy_row(&state->board, dst_r, r);
-        }
-
-        // clear the top most rows which were already toppled but
-        // not overwritten
-        for (; dst_r < state->board.height; dst_r++) {
-            board_clear_row(&state->board, dst_r);
-        }
+        board_remove_rows(&state->board, bot, full_rows);
     }
 
     // register the line clear to the scorer
@@ -708,49 +760,81 @@ void tetris_stick(tetris_state *state) {
 
 
 
-static uint64_t _ticks_to_next(float tick_count, float tick_time) {
+/*
+ * gives the number of frames from tick_time until the next time step of period
+ * tick_count, where both are in units of 1 / tick_den frames (a time step is
+ * the frame during which a multiple of tick_count is reached)
+ */
+static uint64_t _ticks_to_next(uint32_t tick_count, uint32_t tick_den,
+        int32_t tick_time) {
     if (tick_time < 0) {
         // negative values are "dead time", they are used for short pauses in
         // gameplay
-        return (uint64_t) ceil(-tick_time);
+        return (((uint32_t) -tick_time) + tick_den - 1) / tick_den;
     }
-    int64_t res = (int64_t) ceil(tick_count - fmod(tick_time, tick_count));
-    uint64_t ans = (uint64_t) MAX(res, 1);
-    TETRIS_ASSERT(fmod((tick_time + ans), tick_count) < 1);
-    return ans;
+    uint32_t left = tick_count - ((uint32_t) tick_time) % tick_count;
+    return (left + tick_den - 1) / tick_den;
 }
 
 
 void tetris_tick(tetris_state *s) {
     s->time++;
 
-    float thresh = MAX(s->major_tick_count, s->minor_tick_count);
-    s->major_tick_time++;
-    while (s->major_tick_time >= thresh) {
-        s->major_tick_time -= thresh;
+    s->major_tick_time += s->tick_den;
+    if (s->major_tick_time >= (int32_t) s->major_tick_count) {
+        s->major_tick_time -= s->major_tick_count;
     }
 
     s->key_callback_time++;
-    while (s->key_callback_time >= s->key_callback_count) {
+    if (s->key_callback_time >= s->key_callback_count) {
         s->key_callback_time -= s->key_callback_count;
     }
 }
 
 
-static void _tick_by(tetris_state *s, uint64_t ticks) {
-    s->time += ticks;
+static void _pose_tick_by(tetris_state *s, tetris_pose *pose,
+        uint64_t ticks) {
+    pose->time += ticks;
 
-    float thresh = MAX(s->major_tick_count, s->minor_tick_count);
-    s->major_tick_time += ticks;
-    while (s->major_tick_time >= thresh) {
-        s->major_tick_time -= thresh;
+    int64_t major_tick_time = pose->major_tick_time +
+        ((int64_t) ticks) * s->tick_den;
+    if (major_tick_time >= s->major_tick_count) {
+        major_tick_time %= s->major_tick_count;
     }
+    pose->major_tick_time = (int32_t) major_tick_time;
 
-    s->key_callback_time += ticks;
-    while (s->key_callback_time >= s->key_callback_count) {
-        s->key_callback_time -= s->key_callback_count;
+    pose->key_callback_time = (uint32_t)
+        ((pose->key_callback_time + ticks) % s->key_callback_count);
+}
+
+
+/*
+ * moves the falling piece of pose down by n rows, as gravity does over n major
+ * time steps, each of which must have room for the piece to fall into
+ */
+static void _pose_drop(tetris_pose *pose, uint32_t n) {
+    piece_move(&pose->falling_piece, 0, -n);
+    int8_t y = pose->falling_piece.board_y;
+
+    // unset hit ground last frame flag, in case it was set and the
+    // piece was subsequently moved off the platform
+    pose->fp_data.falling_status &= ~HIT_GROUND_LAST_FRAME;
+    pose->fp_data.ground_hit_count = 0;
+
+    // check to see if min y has increased. Once a drop goes below the old
+    // minimum, every drop after it does too, so the time is only counted if
+    // none of them did
+    if (pose->fp_data.min_h > y) {
+        pose->fp_data.min_h = y;
+        pose->fp_data.min_h_inc_time = 0;
+    }
+    else {
+        pose->fp_data.min_h_inc_time =
+            MIN(pose->fp_data.min_h_inc_time + n, MAX_MIN_H_INC_TIME);
     }
 
+    // unset last action was rotate flag in scorer
+    pose->scorer_status &= ~SCORER_LAST_ACTION_WAS_ROTATE;
 }
 
 
@@ -762,20 +846,53 @@ static void _tick_by(tetris_state *s, uint64_t ticks) {
  * not placed and the game was able to advance by ticks, then 0 is returned
  */
 int tetris_advance_by_transient(tetris_state *state, uint64_t *ticks) {
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, state);
+    int ret = tetris_pose_advance_by(state, &pose, ticks);
+    tetris_pose_set(state, &pose);
+
+    return ret;
+}
+
+int tetris_pose_advance_by(tetris_state *state, tetris_pose *pose,
+        uint64_t *ticks) {
     uint64_t diff;
     int ret = 0;
 
     uint64_t t = *ticks;
+    // frames between major time steps
+    uint64_t period = state->major_tick_count / state->tick_den;
 
     while (t > 0) {
         // number of ticks until next major time step
-        diff = _ticks_to_next(state->major_tick_count, state->major_tick_time);
+        diff = _ticks_to_next(state->major_tick_count, state->tick_den,
+                pose->major_tick_time);
+
+        // major time steps come every period ticks after the next one, so if
+        // there are several of them in the ticks left, every one of them
+        // until the piece reaches the ground just drops it by a row, which
+        // can all be done at once
+        uint64_t n_steps = (diff <= t) ? 1 + (t - diff) / period : 0;
+        uint32_t n_free = 0;
+        if (n_steps > 1 && pose->state != GAME_OVER) {
+            n_free = pose->falling_piece.board_y -
+                board_landing_row(&state->board, pose->falling_piece);
+        }
 
-        if (diff <= t) {
-            _tick_by(state, diff);
+        if (n_free > 0) {
+            uint32_t n_drops = MIN(n_steps, n_free);
+            uint64_t skip = diff + (n_drops - 1) * period;
+
+            _pose_tick_by(state, pose, skip);
+            _pose_drop(pose, n_drops);
+            t -= skip;
+        }
+        else if (diff <= t) {
+            _pose_tick_by(state, pose, diff);
 
             // we moved to a major time step, so advance the game state
-            int res = tetris_advance_transient(state);
+            int res = tetris_pose_advance(state, pose);
             t -= diff;
 
             if (res == ADVANCE_PLACED_PIECE || res == ADVANCE_FAIL) {
@@ -786,7 +903,7 @@ int tetris_advance_by_transient(tetris_state *state, uint64_t *ticks) {
             }
         }
         else {
-            _tick_by(state, t);
+            _pose_tick_by(state, pose, t);
             t = 0;
         }
     }
@@ -804,20 +921,36 @@ int tetris_advance_by_transient(tetris_state *state, uint64_t *ticks) {
  * returns 0 if the piece dropped
  */
 int tetris_advance_until_drop_transient(tetris_state *state) {
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, state);
+    int ret = tetris_pose_advance_until_drop(state, &pose);
+    tetris_pose_set(state, &pose);
+
+    return ret;
+}
+
+int tetris_pose_advance_until_drop(tetris_state *state, tetris_pose *pose) {
 
-    piece_t prev_piece;
     int ret;
 
-    do {
-        uint64_t ticks_to_next_major_ts =
-            _ticks_to_next(state->major_tick_count, state->major_tick_time);
+    // only gravity moves the piece here, so if it is already resting where it
+    // would land it can only stick, otherwise it drops by exactly one row
+    int32_t start_y = pose->falling_piece.board_y;
+    int grounded =
+        board_landing_row(&state->board, pose->falling_piece) == start_y;
 
-        prev_piece = state->falling_piece;
+    do {
+        uint64_t ticks_to_next_major_ts = _ticks_to_next(
+                state->major_tick_count, state->tick_den,
+                pose->major_tick_time);
 
-        ret = tetris_advance_by_transient(state, &ticks_to_next_major_ts);
+        ret = tetris_pose_advance_by(state, pose, &ticks_to_next_major_ts);
 
         // loop until either the piece sticks or the piece moves
-    } while (ret == 0 && piece_equals(prev_piece, state->falling_piece));
+    } while (ret == 0 && (grounded || pose->falling_piece.board_y == start_y));
+
+    TETRIS_ASSERT(ret == 1 || pose->falling_piece.board_y == start_y - 1);
 
     return ret;
 }
@@ -825,17 +958,32 @@ int tetris_advance_until_drop_transient(tetris_state *state) {
 
 
 int tetris_is_major_time_step(tetris_state *s) {
-    float major_tick_time = fmod(s->major_tick_time, s->major_tick_count);
-    return s->major_tick_time >= 0 && major_tick_time < 1;
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, s);
+    return tetris_pose_is_major_time_step(s, &pose);
 }
 
 int tetris_is_minor_time_step(tetris_state *s) {
-    float minor_tick_time = fmod(s->major_tick_time, s->minor_tick_count);
-    return s->major_tick_time >= 0 && minor_tick_time < 1;
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, s);
+    return tetris_pose_is_minor_time_step(s, &pose);
+}
+
+int tetris_pose_is_major_time_step(tetris_state *s, const tetris_pose *pose) {
+    // major tick time is always less than major tick count
+    return pose->major_tick_time >= 0 &&
+        pose->major_tick_time < (int32_t) s->tick_den;
+}
+
+int tetris_pose_is_minor_time_step(tetris_state *s, const tetris_pose *pose) {
+    return pose->major_tick_time >= 0 &&
+        ((uint32_t) pose->major_tick_time) % s->minor_tick_count < s->tick_den;
 }
 
 int tetris_is_key_callback_step(tetris_state *s) {
-    return s->key_callback_time < 1;
+    return s->key_callback_time == 0;
 }
 
 
@@ -849,8 +997,18 @@ void tetris_advance_to_next_action(tetris_state *s) {
 }
 
 int tetris_advance_to_next_minor_time_step(tetris_state *s) {
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, s);
+    int ret = tetris_pose_advance_to_next_minor_time_step(s, &pose);
+    tetris_pose_set(s, &pose);
+
+    return ret;
+}
+
+int tetris_pose_advance_to_next_minor_time_step(tetris_state *s,
+        tetris_pose *pose) {
     int ret;
-    float minor_tick_time;
     uint64_t ticks_to_next_minor_ts;
 
     if (s->major_tick_count <= s->minor_tick_count) {
@@ -860,13 +1018,13 @@ int tetris_advance_to_next_minor_time_step(tetris_state *s) {
     }
 
     do {
-        minor_tick_time = s->major_tick_time;
-        ticks_to_next_minor_ts =
-            _ticks_to_next(s->minor_tick_count, minor_tick_time);
-        ret = tetris_advance_by_transient(s, &ticks_to_next_minor_ts);
-    } while(ret == 0 && (tetris_is_major_time_step(s) || !tetris_is_minor_time_step(s)));
+        ticks_to_next_minor_ts = _ticks_to_next(s->minor_tick_count,
+                s->tick_den, pose->major_tick_time);
+        ret = tetris_pose_advance_by(s, pose, &ticks_to_next_minor_ts);
+    } while(ret == 0 && (tetris_pose_is_major_time_step(s, pose) ||
+                !tetris_pose_is_minor_time_step(s, pose)));
 
-    TETRIS_ASSERT(tetris_is_minor_time_step(s) || ret == 1);
+    TETRIS_ASSERT(tetris_pose_is_minor_time_step(s, pose) || ret == 1);
 
     return ret;
 }
@@ -901,14 +1059,24 @@ int tetris_advance(tetris_state *s) {
 }
 
 int tetris_advance_transient(tetris_state *s) {
+    tetris_pose pose;
+
+    tetris_pose_get(&pose, s);
+    int ret = tetris_pose_advance(s, &pose);
+    tetris_pose_set(s, &pose);
+
+    return ret;
+}
+
+int tetris_pose_advance(tetris_state *s, tetris_pose *pose) {
     piece_t falling;
 
-    if (s->state == GAME_OVER) {
+    if (pose->state == GAME_OVER) {
         // don't advance
         return ADVANCE_FAIL;
     }
 
-    falling = s->falling_piece;
+    falling = pose->falling_piece;
 
     // the falling piece must always have been initialized before this point
     TETRIS_ASSERT(falling.piece_idx != EMPTY);
@@ -923,10 +1091,10 @@ int tetris_advance_transient(tetris_state *s) {
     if (board_piece_collides(&s->board, new_falling)) {
         // then the piece cannot move down, it is now stuck where it was.
 
-        if (s->fp_data.falling_status & HIT_GROUND_LAST_FRAME) {
+        if (pose->fp_data.falling_status & HIT_GROUND_LAST_FRAME) {
             // if the piece spend two successive frames hitting the ground,
             // we stick it wherever it is
-            _reset_fp_data(&s->fp_data);
+            _reset_fp_data(&pose->fp_data);
 
             // try to see if the piece can be stuck down here
             int placed = board_can_place_piece(&s->board, falling);
@@ -934,7 +1102,7 @@ int tetris_advance_transient(tetris_state *s) {
             if (!placed) {
                 // if we could not place this piece even partially on the
                 // board, then the game is over
-                s->state = GAME_OVER;
+                pose->state = GAME_OVER;
                 return ADVANCE_FAIL;
             }
 
@@ -945,30 +1113,31 @@ int tetris_advance_transient(tetris_state *s) {
             // if we were not hitting the ground last frame, then we set
             // this flag and allow the player to try moving the piece again
             // before it sticks
-            s->fp_data.falling_status |= HIT_GROUND_LAST_FRAME;
+            pose->fp_data.falling_status |= HIT_GROUND_LAST_FRAME;
 
 
-            float mtc = s->major_tick_count;
+            int32_t mtc = s->major_tick_count;
+            int32_t den = s->tick_den;
             // artificially advance time forward to
             // CTRL_HIT_GROUND_LAST_DELAY% of major time step delay before
             // the next major time step
-            if (mtc >= MAX_CTRL_GROUND_HIT_DELAY -
-                       MIN_CTRL_GROUND_HIT_DELAY) {
+            if (mtc >= (MAX_CTRL_GROUND_HIT_DELAY -
+                        MIN_CTRL_GROUND_HIT_DELAY) * den) {
                 // if major tick count is greater than the max delay, then we
                 // have already waited long enough for the stick to piece, we
                 // can make it stick next frame
-                s->major_tick_time = -MIN_CTRL_GROUND_HIT_DELAY;
+                pose->major_tick_time = -MIN_CTRL_GROUND_HIT_DELAY * den;
             }
-            else if (mtc <= MAX_CTRL_GROUND_HIT_DELAY -
-                            CTRL_HIT_GROUND_LAST_DELAY) {
+            else if (mtc <= (MAX_CTRL_GROUND_HIT_DELAY -
+                             CTRL_HIT_GROUND_LAST_DELAY) * den) {
                 // otherwise if major tick count is smaller than the difference
                 // between the ground hit delay and the max ground hit delay,
                 // delay as much as possible
-                s->major_tick_time = -CTRL_HIT_GROUND_LAST_DELAY;
+                pose->major_tick_time = -CTRL_HIT_GROUND_LAST_DELAY * den;
             }
             else {
                 // otherwise, linearly interpolate between the two above cases
-                s->major_tick_time = (mtc - MAX_CTRL_GROUND_HIT_DELAY);
+                pose->major_tick_time = mtc - MAX_CTRL_GROUND_HIT_DELAY * den;
             }
 
             return ADVANCE_STALLED;
@@ -976,25 +1145,7 @@ int tetris_advance_transient(tetris_state *s) {
     }
     else {
         // otherwise, the piece can now be moved down into the new location
-        s->falling_piece = new_falling;
-
-        // unset hit ground last frame flag, in case it was set and the
-        // piece was subsequently moved off the platform
-        s->fp_data.falling_status &= ~HIT_GROUND_LAST_FRAME;
-        s->fp_data.ground_hit_count = 0;
-
-        // check to see if min y has increased
-        if (s->fp_data.min_h > s->falling_piece.board_y) {
-            s->fp_data.min_h = s->falling_piece.board_y;
-            s->fp_data.min_h_inc_time = 0;
-        }
-        else {
-            s->fp_data.min_h_inc_time =
-                MIN(s->fp_data.min_h_inc_time + 1, MAX_MIN_H_INC_TIME);
-        }
-
-        // unset last action was rotate flag in scorer
-        s->scorer.status &= ~SCORER_LAST_ACTION_WAS_ROTATE;
+        _pose_drop(pose, 1);
 
         // that is the completion of this move
         return ADVANCE_MOVED_PIECE;
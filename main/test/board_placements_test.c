@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <math/random.h>
+
+#include <tetris.h>
+#include <board.h>
+#include <piece.h>
+#include <tetris_state.h>
+
+
+// number of board_y and board_x values the search covers, which go from one
+// bounding box below the floor to one above the top, and from the leftmost
+// position a piece can be represented at to the right wall
+#define N_Y (TETRIS_HEIGHT + 2 * PIECE_BB_H)
+#define N_X (TETRIS_WIDTH + PIECE_MASK_OFF)
+
+
+/*
+ * marks pose as found if it hasn't been already, pushing it onto queue
+ */
+static void _visit(tetris_pose *pose, uint8_t seen[][N_Y][N_X],
+        tetris_pose *queue, uint32_t *n_queue) {
+    piece_t *p = &pose->falling_piece;
+
+    // rows above the search are empty, so a piece above them can fall back
+    // down to the highest one, which is where board_piece_placements puts it
+    if (p->board_y + PIECE_BB_H >= N_Y) {
+        p->board_y = N_Y - 1 - PIECE_BB_H;
+    }
+
+    uint8_t *s = &seen[p->orientation][p->board_y + PIECE_BB_H]
+        [p->board_x + PIECE_MASK_OFF];
+    if (!*s) {
+        *s = 1;
+        queue[(*n_queue)++] = *pose;
+    }
+}
+
+
+/*
+ * finds the positions the piece can lock in the slow way, by searching over
+ * every pose the game itself lets the piece move to, in the order
+ * board_piece_placements gives them
+ */
+static uint32_t _ref_placements(tetris_state *s, piece_t piece,
+        piece_t *placements) {
+    static uint8_t seen[N_PIECE_ORIENTATIONS][N_Y][N_X];
+    static tetris_pose queue[N_PIECE_ORIENTATIONS * N_Y * N_X];
+    uint32_t n_queue = 0;
+
+    memset(seen, 0, sizeof(seen));
+
+    tetris_pose pose;
+    tetris_pose_get(&pose, s);
+    pose.falling_piece = piece;
+    _visit(&pose, seen, queue, &n_queue);
+
+    for (uint32_t i = 0; i < n_queue; i++) {
+        tetris_pose next;
+
+        next = queue[i];
+        if (tetris_pose_move(s, &next, -1, 0)) {
+            _visit(&next, seen, queue, &n_queue);
+        }
+        next = queue[i];
+        if (tetris_pose_move(s, &next, 1, 0)) {
+            _visit(&next, seen, queue, &n_queue);
+        }
+        next = queue[i];
+        if (tetris_pose_move(s, &next, 0, -1)) {
+            _visit(&next, seen, queue, &n_queue);
+        }
+        next = queue[i];
+        if (tetris_pose_rotate(s, &next, ROTATE_CLOCKWISE, 1)) {
+            _visit(&next, seen, queue, &n_queue);
+        }
+        next = queue[i];
+        if (tetris_pose_rotate(s, &next, ROTATE_COUNTERCLOCKWISE, 1)) {
+            _visit(&next, seen, queue, &n_queue);
+        }
+    }
+
+    uint32_t n = 0;
+    for (uint8_t o = 0; o < N_PIECE_ORIENTATIONS; o++) {
+        for (int32_t yi = 0; yi < N_Y; yi++) {
+            for (int32_t xi = 0; xi < N_X; xi++) {
+                if (!seen[o][yi][xi]) {
+                    continue;
+                }
+
+                piece_t p = piece;
+                p.orientation = o;
+                p.board_x = xi - PIECE_MASK_OFF;
+                p.board_y = yi - PIECE_BB_H;
+
+                // the piece locks wherever it can't move down any farther
+                piece_t below = p;
+                piece_move(&below, 0, -1);
+                if (board_piece_collides(&s->board, below)) {
+                    placements[n++] = p;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+
+static int _pieces_eq(piece_t p1, piece_t p2) {
+    return p1.piece_idx == p2.piece_idx && p1.orientation == p2.orientation &&
+        p1.board_x == p2.board_x && p1.board_y == p2.board_y;
+}
+
+
+
+int main(int argc, char *argv[]) {
+    tetris_state s;
+    static piece_t placements[BOARD_MAX_PLACEMENTS];
+    static piece_t ref[BOARD_MAX_PLACEMENTS];
+
+    seed_rand(0, 0);
+
+    tetris_state_init(&s);
+    board_t *b = &s.board;
+
+    uint64_t n_checked = 0;
+    uint64_t n_mismatched = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        piece_t piece;
+        piece_init(&piece, 1 + gen_rand_r(N_PIECES), TETRIS_WIDTH,
+                TETRIS_HEIGHT);
+
+        if (board_piece_collides(b, piece)) {
+            // the board has filled up, so start over
+            board_clear(b);
+            continue;
+        }
+
+        // search from where the piece spawns on even boards, and otherwise
+        // from a random spot it fits in, often up against the top of the
+        // search where kicks can take it higher
+        if (i % 2 == 1) {
+            do {
+                piece.orientation = gen_rand_r(N_PIECE_ORIENTATIONS);
+                piece.board_x = gen_rand_r(N_X) - PIECE_MASK_OFF;
+                piece.board_y = N_Y - 1 - PIECE_BB_H - ((gen_rand_r(2) == 0) ?
+                    0 : gen_rand_r(N_Y));
+            } while (board_piece_collides(b, piece));
+        }
+
+        uint32_t n = board_piece_placements(b, piece, placements);
+        uint32_t n_ref = _ref_placements(&s, piece, ref);
+
+        int eq = (n == n_ref);
+        for (uint32_t j = 0; eq && j < n; j++) {
+            eq = _pieces_eq(placements[j], ref[j]);
+        }
+        if (!eq) {
+            if (n_mismatched < 10) {
+                printf("mismatch on board %d, piece %d: %u placements, %u "
+                        "expected\n", i, piece.piece_idx, n, n_ref);
+            }
+            n_mismatched++;
+        }
+        n_checked++;
+
+        // build up the board by dropping the piece somewhere, clearing any
+        // rows it completes like the game does
+        piece_t drop = placements[gen_rand_r(n)];
+        board_place_piece(b, drop);
+
+        int32_t bot = (drop.board_y > 0) ? drop.board_y : 0;
+        uint32_t full_rows = 0;
+        for (int32_t y = bot; y < drop.board_y + PIECE_BB_H &&
+                y < TETRIS_HEIGHT; y++) {
+            if (board_row_full(b, y)) {
+                full_rows |= 1U << (y - bot);
+            }
+        }
+        if (full_rows != 0) {
+            board_remove_rows(b, bot, full_rows);
+        }
+
+        // knock out a random tile now and then, leaving overhangs for the
+        // pieces to be kicked under
+        if (gen_rand_r(4) == 0) {
+            board_set_tile(b, gen_rand_r(TETRIS_WIDTH),
+                    gen_rand_r(TETRIS_HEIGHT), EMPTY);
+        }
+    }
+
+    tetris_state_destroy(&s);
+
+    printf("%llu pieces checked, %llu mismatched\n",
+            (unsigned long long) n_checked,
+            (unsigned long long) n_mismatched);
+
+    return n_mismatched != 0;
+}
+
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math/random.h>
+
+#include <tetris.h>
+#include <board.h>
+#include <piece.h>
+#include <ais/lha_eval.h>
+
+
+/*
+ * gives whether the tile at (x, y) is occupied, where the walls and floor are
+ * occupied
+ */
+static int _tile(const row_mask_t *rows, int32_t x, int32_t y) {
+    if (x < 0 || x >= TETRIS_WIDTH || y < 0) {
+        return 1;
+    }
+    return (rows[y] >> x) & 1;
+}
+
+
+/*
+ * computes the features of b with piece placed on it the slow way, by placing
+ * the piece on a copy of the board and looking at every tile, without the
+ * column statistics the board maintains
+ */
+static void _ref_features(board_t *b, piece_t piece, struct lha_features *f) {
+    board_t tmp;
+    row_mask_t rows[TETRIS_HEIGHT + 1];
+    uint32_t heights[TETRIS_WIDTH];
+
+    board_deep_copy(&tmp, b);
+    board_place_piece(&tmp, piece);
+
+    for (int32_t y = 0; y < TETRIS_HEIGHT; y++) {
+        rows[y] = tmp.row_masks[y] & tmp.full_row;
+    }
+    // a tile of the piece sticking out of the top of the board makes a hole
+    // of the empty tile below it
+    rows[TETRIS_HEIGHT] = 0;
+    const uint32_t *masks = piece_row_masks(piece);
+    for (int32_t r = 0; r < PIECE_BB_H; r++) {
+        if (piece.board_y + r == TETRIS_HEIGHT) {
+            rows[TETRIS_HEIGHT] = (masks[r] >> PIECE_MASK_OFF) & tmp.full_row;
+        }
+    }
+
+    memset(f, 0, sizeof(struct lha_features));
+
+    for (int32_t x = 0; x < TETRIS_WIDTH; x++) {
+        heights[x] = 0;
+        for (int32_t y = 0; y < TETRIS_HEIGHT; y++) {
+            if (_tile(rows, x, y)) {
+                heights[x] = y + 1;
+            }
+            if (!_tile(rows, x, y) && _tile(rows, x, y + 1)) {
+                f->n_holes++;
+            }
+            f->col_transitions += (_tile(rows, x, y) != _tile(rows, x, y - 1));
+        }
+        for (int32_t y = 0; y < heights[x]; y++) {
+            f->covered_cells += !_tile(rows, x, y);
+        }
+
+        f->aggregate_height += heights[x];
+        if (x > 0) {
+            f->bumpiness += abs((int) heights[x - 1] - (int) heights[x]);
+        }
+        if (heights[x] > f->max_height) {
+            f->max_height = heights[x];
+        }
+    }
+
+    for (int32_t x = 0; x < TETRIS_WIDTH; x++) {
+        int32_t left = (x > 0) ? heights[x - 1] : INT32_MAX;
+        int32_t right = (x < TETRIS_WIDTH - 1) ? heights[x + 1] : INT32_MAX;
+        int32_t rim = (left < right) ? left : right;
+
+        if (rim > (int32_t) heights[x]) {
+            f->well_depths += rim - heights[x];
+        }
+    }
+
+    for (int32_t y = 0; y < TETRIS_HEIGHT; y++) {
+        f->n_complete_lines += (rows[y] == tmp.full_row);
+
+        for (int32_t x = 0; x <= TETRIS_WIDTH; x++) {
+            f->row_transitions += (_tile(rows, x, y) != _tile(rows, x - 1, y));
+        }
+    }
+
+    board_destroy(&tmp);
+}
+
+
+/*
+ * sets the optional features of f which are not in features to 0, the way
+ * lha_eval leaves them
+ */
+static void _mask_features(struct lha_features *f, uint32_t features) {
+    if (!(features & LHA_F_ROW_TRANSITIONS)) {
+        f->row_transitions = 0;
+    }
+    if (!(features & LHA_F_COL_TRANSITIONS)) {
+        f->col_transitions = 0;
+    }
+    if (!(features & LHA_F_WELL_DEPTHS)) {
+        f->well_depths = 0;
+    }
+    if (!(features & LHA_F_COVERED_CELLS)) {
+        f->covered_cells = 0;
+    }
+    if (!(features & LHA_F_MAX_HEIGHT)) {
+        f->max_height = 0;
+    }
+}
+
+
+static int _features_eq(const struct lha_features *f1,
+        const struct lha_features *f2) {
+    return memcmp(f1, f2, sizeof(struct lha_features)) == 0;
+}
+
+
+static void _print_features(const char *name, const struct lha_features *f) {
+    printf("  %-6s height %u lines %u holes %u bumpiness %u row trans %u "
+            "col trans %u wells %u covered %u max height %u\n", name,
+            f->aggregate_height, f->n_complete_lines, f->n_holes,
+            f->bumpiness, f->row_transitions, f->col_transitions,
+            f->well_depths, f->covered_cells, f->max_height);
+}
+
+
+
+/*
+ * checks the features of random placements on random boards, with
+ * lha_eval_batch limited to the kernel named name
+ *
+ * returns the number of placements whose features were wrong
+ */
+static uint64_t _check_kernel(const char *name) {
+    board_t b;
+    piece_t placements[BOARD_MAX_PLACEMENTS];
+    struct lha_features batch[LHA_EVAL_BATCH];
+
+    seed_rand(0, 0);
+
+    board_init(&b, TETRIS_WIDTH, TETRIS_HEIGHT, 0);
+
+    uint64_t n_checked = 0;
+    uint64_t n_mismatched = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        piece_t piece;
+        piece_init(&piece, 1 + gen_rand_r(N_PIECES), TETRIS_WIDTH,
+                TETRIS_HEIGHT);
+
+        uint32_t n = board_piece_placements(&b, piece, placements);
+        if (n == 0) {
+            // the board has filled up, so start over
+            board_clear(&b);
+            continue;
+        }
+
+        // evaluate every placement, in batches of random sizes, with all
+        // features on every other board and a random set of them otherwise
+        uint32_t features = (i % 2 == 0) ? LHA_F_ALL :
+            gen_rand_r(LHA_F_ALL + 1);
+
+        for (uint32_t start = 0; start < n;) {
+            uint32_t n_batch = 1 + gen_rand_r(LHA_EVAL_BATCH);
+            if (n_batch > n - start) {
+                n_batch = n - start;
+            }
+
+            lha_eval_batch(&b, &placements[start], n_batch, features, batch);
+
+            for (uint32_t j = 0; j < n_batch; j++) {
+                struct lha_features single, ref;
+                lha_eval_features(&b, placements[start + j], features,
+                        &single);
+                _ref_features(&b, placements[start + j], &ref);
+                _mask_features(&ref, features);
+
+                if (!_features_eq(&batch[j], &single) ||
+                        !_features_eq(&single, &ref)) {
+                    if (n_mismatched < 10) {
+                        printf("mismatch on board %d, placement %u:\n", i,
+                                start + j);
+                        _print_features("batch", &batch[j]);
+                        _print_features("single", &single);
+                        _print_features("ref", &ref);
+                    }
+                    n_mismatched++;
+                }
+                n_checked++;
+            }
+
+            start += n_batch;
+        }
+
+        // build up the board by dropping the piece somewhere, clearing any
+        // rows it completes like the game does
+        piece_t drop = placements[gen_rand_r(n)];
+        board_place_piece(&b, drop);
+
+        int32_t bot = (drop.board_y > 0) ? drop.board_y : 0;
+        uint32_t full_rows = 0;
+        for (int32_t y = bot; y < drop.board_y + PIECE_BB_H &&
+                y < TETRIS_HEIGHT; y++) {
+            if (board_row_full(&b, y)) {
+                full_rows |= 1U << (y - bot);
+            }
+        }
+        if (full_rows != 0) {
+            board_remove_rows(&b, bot, full_rows);
+        }
+    }
+
+    board_destroy(&b);
+
+    printf("%s: %llu placements checked, %llu mismatched\n", name,
+            (unsigned long long) n_checked,
+            (unsigned long long) n_mismatched);
+
+    return n_mismatched;
+}
+
+
+
+int main(int argc, char *argv[]) {
+    static const char * const names[] = {
+        [LHA_KERNEL_SCALAR] = "scalar",
+        [LHA_KERNEL_SSE2] = "sse2",
+        [LHA_KERNEL_AVX2] = "avx2"
+    };
+    uint64_t n_mismatched = 0;
+
+    for (int k = LHA_KERNEL_SCALAR; k <= LHA_KERNEL_AVX2; k++) {
+        if (lha_eval_max_kernel(k) != k) {
+            printf("%s: not supported here\n", names[k]);
+            continue;
+        }
+        n_mismatched += _check_kernel(names[k]);
+    }
+
+    return n_mismatched != 0;
+}
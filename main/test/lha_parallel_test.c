@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <headless.h>
+#include <tetris_state.h>
+#include <ais/linear_heuristic.h>
+
+
+// games are played to this many ticks, which is a few hundred pieces
+#define MAX_TICKS 20000
+
+#define DEPTH 3
+#define N_THREADS 4
+#define N_SEEDS 3
+
+
+/*
+ * the agent playing a game along with where the falling piece was after
+ * each of its moves
+ */
+struct traced_agent {
+    lha_t *a;
+
+    piece_t *trace;
+    uint64_t n_moves;
+};
+
+
+static int _traced_go(void *arg, tetris_state *s) {
+    struct traced_agent *t = (struct traced_agent *) arg;
+
+    int ret = linear_heuristic_go(t->a, s);
+    if (t->n_moves < MAX_TICKS) {
+        t->trace[t->n_moves++] = s->falling_piece;
+    }
+    return ret;
+}
+
+
+/*
+ * plays the game from seed with an agent searching on n_threads threads, with
+ * its transposition table and expansion cache on if tables is set, recording
+ * its moves in t
+ */
+static void _play(uint64_t seed, int n_threads, int tables,
+        struct traced_agent *t, struct headless_result *res) {
+    t->a = linear_heuristic_agent_init();
+    t->a->depth = DEPTH;
+    t->a->n_threads = n_threads;
+    if (!tables) {
+        t->a->tt_log_n_entries = 0;
+        t->a->xcache_log_n_entries = 0;
+    }
+    t->n_moves = 0;
+
+    headless_play(seed, 0, MAX_TICKS, &_traced_go, t, res);
+
+    linear_heuristic_agent_destroy(t->a);
+}
+
+
+static int _pieces_eq(piece_t p1, piece_t p2) {
+    return p1.piece_idx == p2.piece_idx && p1.orientation == p2.orientation &&
+        p1.board_x == p2.board_x && p1.board_y == p2.board_y;
+}
+
+
+
+int main(int argc, char *argv[]) {
+    struct traced_agent serial, parallel;
+    struct headless_result s_res, p_res;
+    int n_mismatched = 0;
+
+    serial.trace = (piece_t *) malloc(MAX_TICKS * sizeof(piece_t));
+    parallel.trace = (piece_t *) malloc(MAX_TICKS * sizeof(piece_t));
+    if (serial.trace == NULL || parallel.trace == NULL) {
+        return -1;
+    }
+
+    for (int tables = 0; tables <= 1; tables++) {
+        for (uint64_t seed = 1; seed <= N_SEEDS; seed++) {
+            _play(seed, 1, tables, &serial, &s_res);
+            _play(seed, N_THREADS, tables, &parallel, &p_res);
+
+            // the searches must agree on every move, not just the outcome
+            uint64_t first_diff = 0;
+            while (first_diff < serial.n_moves &&
+                    first_diff < parallel.n_moves &&
+                    _pieces_eq(serial.trace[first_diff],
+                        parallel.trace[first_diff])) {
+                first_diff++;
+            }
+
+            int eq = (serial.n_moves == parallel.n_moves &&
+                    first_diff == serial.n_moves &&
+                    s_res.score == p_res.score);
+            printf("seed %llu, tables %s: %llu moves, score %d, %s\n",
+                    (unsigned long long) seed, tables ? "on" : "off",
+                    (unsigned long long) serial.n_moves, s_res.score,
+                    eq ? "same" : "DIFFERENT");
+            if (!eq) {
+                printf("  first differs at move %llu, parallel score %d\n",
+                        (unsigned long long) first_diff, p_res.score);
+                n_mismatched++;
+            }
+        }
+    }
+
+    free(serial.trace);
+    free(parallel.trace);
+
+    return n_mismatched != 0;
+}
+
@@ -0,0 +1,239 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ai.h>
+#include <ais/linear_heuristic.h>
+#include <headless.h>
+#include <tutil.h>
+
+
+/*
+ * Plays many seeded games of one of the builtin AIs without graphics, several
+ * at a time on a pool of threads (each game with its own instance of the AI),
+ * and reports how fast they were played and how well the AI did
+ */
+
+
+// default number of games to play
+#define DEFAULT_N_GAMES 100
+
+
+struct batch_params {
+    const struct ai *ai_type;
+    uint32_t n_games;
+    uint32_t n_threads;
+    uint64_t seed;
+    uint64_t max_ticks;
+    uint32_t level;
+};
+
+
+struct batch_run {
+    const struct batch_params *params;
+    // result of each game
+    struct headless_result *games;
+    // transposition table counts of each game, if the AI is the linear
+    // heuristic agent
+    trans_table_stats *tt_stats;
+};
+
+
+
+static void _play(void *arg, uint32_t i) {
+    struct batch_run *run = (struct batch_run *) arg;
+    const struct batch_params *params = run->params;
+    struct ai ai;
+
+    // games are already played in parallel
+    ai_init(&ai, params->ai_type, AI_SINGLE_THREADED);
+    headless_play(params->seed + i, params->level, params->max_ticks,
+            ai.callback, ai.ai_struct_ptr, &run->games[i]);
+    if (run->tt_stats != NULL) {
+        linear_heuristic_agent_tt_stats((lha_t *) ai.ai_struct_ptr,
+                &run->tt_stats[i]);
+    }
+    ai_destroy(&ai);
+}
+
+
+static int _double_cmp(const void *a, const void *b) {
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return (da > db) - (da < db);
+}
+
+
+/*
+ * prints the distribution of the n values vals, which are sorted in place
+ */
+static void _print_dist(const char *name, double *vals, uint32_t n) {
+    double mean = 0;
+    double var = 0;
+
+    qsort(vals, n, sizeof(double), &_double_cmp);
+
+    for (uint32_t i = 0; i < n; i++) {
+        mean += vals[i] / n;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        var += (vals[i] - mean) * (vals[i] - mean) / n;
+    }
+
+    printf("%-6s mean %10.1f  stddev %10.1f  min %8.0f  p10 %8.0f  "
+            "median %8.0f  p90 %8.0f  max %8.0f\n", name, mean, sqrt(var),
+            vals[0], vals[n / 10], vals[n / 2], vals[(n * 9) / 10],
+            vals[n - 1]);
+}
+
+
+static int usage(char *argv[]) {
+    return headless_usage(argv[0], "[-a ai] [-n games] [-t threads] "
+            "[-s first seed] [-m max ticks] [-l level] [-v]");
+}
+
+
+int main(int argc, char *argv[]) {
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    // when set, print the result of every game
+    int verbose = 0;
+
+    struct batch_params params = {
+        .ai_type = fetch_ai("lh"),
+        .n_games = DEFAULT_N_GAMES,
+        .n_threads = (n_cpus > 1) ? (uint32_t) n_cpus : 1,
+        .seed = time(NULL),
+        .max_ticks = HEADLESS_DEFAULT_MAX_TICKS,
+        .level = 0
+    };
+
+    int opt;
+    uint64_t val;
+    while ((opt = getopt(argc, argv, "a:n:t:s:m:l:v")) != -1) {
+        switch (opt) {
+            case 'a':
+                params.ai_type = fetch_ai(optarg);
+                if (params.ai_type == NULL) {
+                    fprintf(stderr, "%s is not a builtin AI name\n", optarg);
+                    return -1;
+                }
+                continue;
+            case 'v':
+                verbose = 1;
+                continue;
+            case '?':
+                return usage(argv);
+        }
+
+        // the seed and tick count are 64 bits wide, everything else 32
+        uint64_t max = (opt == 's' || opt == 'm') ? UINT64_MAX : UINT32_MAX;
+        if (headless_parse_u64(optarg, max, &val) != 0) {
+            return usage(argv);
+        }
+        switch (opt) {
+            case 'n':
+                params.n_games = val;
+                break;
+            case 't':
+                params.n_threads = val;
+                break;
+            case 's':
+                params.seed = val;
+                break;
+            case 'm':
+                params.max_ticks = val;
+                break;
+            case 'l':
+                params.level = val;
+                break;
+        }
+    }
+    if (params.n_games == 0 || params.n_threads == 0) {
+        return usage(argv);
+    }
+
+    struct headless_result *games = (struct headless_result *) calloc(
+            params.n_games, sizeof(struct headless_result));
+    TETRIS_ASSERT(games != NULL);
+
+    printf("playing %u games of %s on %u threads, seeds %llu to %llu\n",
+            params.n_games, params.ai_type->name, params.n_threads,
+            (unsigned long long) params.seed,
+            (unsigned long long) (params.seed + params.n_games - 1));
+    fflush(stdout);
+
+    struct batch_run run = {
+        .params = &params,
+        .games = games,
+        .tt_stats = NULL
+    };
+    if (strcmp(params.ai_type->name, "lh") == 0) {
+        run.tt_stats = (trans_table_stats *) calloc(params.n_games,
+                sizeof(trans_table_stats));
+        TETRIS_ASSERT(run.tt_stats != NULL);
+    }
+
+    uint64_t start = tetris_time_ns();
+    headless_run_jobs(params.n_games, params.n_threads, &_play, &run);
+    double secs = (tetris_time_ns() - start) / 1e9;
+
+    uint64_t pieces = 0;
+    uint64_t ticks = 0;
+    uint32_t n_over = 0;
+    double *scores = (double *) malloc(params.n_games * sizeof(double));
+    double *lines = (double *) malloc(params.n_games * sizeof(double));
+    TETRIS_ASSERT(scores != NULL && lines != NULL);
+
+    for (uint32_t i = 0; i < params.n_games; i++) {
+        struct headless_result *g = &games[i];
+
+        if (verbose) {
+            printf("seed %llu: score %d lines %d level %u pieces %llu "
+                    "ticks %llu%s\n",
+                    (unsigned long long) (params.seed + i), g->score,
+                    g->lines, g->level, (unsigned long long) g->pieces,
+                    (unsigned long long) g->ticks,
+                    g->over ? "" : " (out of time)");
+        }
+
+        pieces += g->pieces;
+        ticks += g->ticks;
+        n_over += g->over;
+        scores[i] = g->score;
+        lines[i] = g->lines;
+    }
+
+    printf("%u games in %.2fs (%u topped out, %u out of time)\n",
+            params.n_games, secs, n_over, params.n_games - n_over);
+    printf("%.2f games/s, %.1f pieces/s, %.0f ticks/s\n",
+            params.n_games / secs, pieces / secs, ticks / secs);
+    _print_dist("score", scores, params.n_games);
+    _print_dist("lines", lines, params.n_games);
+
+    if (run.tt_stats != NULL) {
+        trans_table_stats tt = { 0, 0, 0 };
+        for (uint32_t i = 0; i < params.n_games; i++) {
+            tt.hits += run.tt_stats[i].hits;
+            tt.misses += run.tt_stats[i].misses;
+            tt.evictions += run.tt_stats[i].evictions;
+        }
+
+        uint64_t lookups = tt.hits + tt.misses;
+        printf("tt     hits %llu (%.1f%%)  misses %llu  evictions %llu\n",
+                (unsigned long long) tt.hits,
+                (lookups == 0) ? 0. : 100. * tt.hits / lookups,
+                (unsigned long long) tt.misses,
+                (unsigned long long) tt.evictions);
+        free(run.tt_stats);
+    }
+
+    free(scores);
+    free(lines);
+    free(games);
+
+    return 0;
+}
@@ -0,0 +1,614 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <math/random.h>
+
+#include <tetris_state.h>
+#include <ais/linear_heuristic.h>
+#include <headless.h>
+#include <tutil.h>
+
+
+/*
+ * Tunes the weights of the linear heuristic agent by self-play, with CMA-ES
+ * (the covariance matrix adaptation evolution strategy). Each generation, a
+ * population of weight vectors is sampled from a multivariate normal
+ * distribution, every one of them plays the same set of seeded games (spread
+ * over all cores), and the distribution is moved towards the ones which
+ * cleared the most lines
+ *
+ * The heuristic only ranks landing spots against each other, so scaling the
+ * weights does not change how the agent plays. Weights are normalized to unit
+ * length before they are played with, and the search distribution is rescaled
+ * to keep its mean at unit length
+ */
+
+
+#define N N_CNSTS
+
+
+// default number of generations to run
+#define DEFAULT_N_GENERATIONS 100
+
+// default number of games each weight vector plays per generation
+#define DEFAULT_N_GAMES 32
+
+// default lookahead depth of the agents. Weights tuned at depth 1 carry over
+// well to deeper searches, which are much slower to play with
+#define DEFAULT_DEPTH 1
+
+// initial step size of the search, relative to the (unit length) mean
+#define INITIAL_SIGMA .3
+
+// number of sweeps of the Jacobi eigenvalue algorithm to do at most when
+// decomposing the covariance matrix
+#define MAX_JACOBI_SWEEPS 64
+
+
+struct tune_params {
+    uint32_t n_generations;
+    uint32_t n_games;
+    uint32_t n_threads;
+    uint32_t depth;
+    uint64_t max_ticks;
+    uint64_t seed;
+    // population size, or 0 to use the default for the number of weights
+    uint32_t lambda;
+};
+
+
+/*
+ * state of the CMA-ES search, following the notation of Hansen's "The CMA
+ * Evolution Strategy: A Tutorial"
+ */
+struct cma {
+    // population size and number of parents
+    uint32_t lambda;
+    uint32_t mu;
+    // recombination weights of the mu best samples, and their variance
+    // effective selection mass
+    double *w;
+    double mu_eff;
+
+    // learning rates and damping
+    double c_sigma;
+    double d_sigma;
+    double c_c;
+    double c_1;
+    double c_mu;
+    // expected length of a standard normally distributed vector
+    double chi_n;
+
+    // mean and step size of the distribution
+    double mean[N];
+    double sigma;
+    // covariance matrix, and its eigendecomposition C = B diag(D^2) B^T
+    double C[N][N];
+    double B[N][N];
+    double D[N];
+    // evolution paths
+    double p_sigma[N];
+    double p_c[N];
+
+    // generation number, starting from 0
+    uint32_t gen;
+
+    // this generation's samples, lambda of them, and their steps y = (x - m)
+    // / sigma from the mean
+    double (*x)[N];
+    double (*y)[N];
+};
+
+
+/*
+ * a game to be played by one of the weight vectors of the population
+ */
+struct tune_job {
+    const float *cnsts;
+    uint64_t seed;
+    // number of lines cleared and ticks played, written by the worker
+    uint32_t lines;
+    uint64_t ticks;
+};
+
+
+struct tune_run {
+    const struct tune_params *params;
+    struct tune_job *jobs;
+};
+
+
+
+/*
+ * gives a standard normally distributed random number, from the calling
+ * thread's random number generator
+ */
+static double _gen_normal() {
+    // Box-Muller transform, with the uniforms in (0, 1) so the log is finite
+    double u1 = (gen_rand() + .5) / 4294967296.;
+    double u2 = (gen_rand() + .5) / 4294967296.;
+    return sqrt(-2. * log(u1)) * cos(2. * M_PI * u2);
+}
+
+
+static double _norm(const double *v) {
+    double s = 0;
+    for (uint32_t i = 0; i < N; i++) {
+        s += v[i] * v[i];
+    }
+    return sqrt(s);
+}
+
+
+/*
+ * computes the eigendecomposition of the symmetric matrix C with the cyclic
+ * Jacobi method, writing the eigenvectors to the columns of B and the square
+ * roots of the eigenvalues to D
+ */
+static void _eigen(const double C[N][N], double B[N][N], double *D) {
+    double A[N][N];
+
+    memcpy(A, C, sizeof(A));
+    for (uint32_t i = 0; i < N; i++) {
+        for (uint32_t j = 0; j < N; j++) {
+            B[i][j] = (i == j);
+        }
+    }
+
+    for (uint32_t sweep = 0; sweep < MAX_JACOBI_SWEEPS; sweep++) {
+        double off = 0;
+        for (uint32_t p = 0; p < N; p++) {
+            for (uint32_t q = p + 1; q < N; q++) {
+                off += A[p][q] * A[p][q];
+            }
+        }
+        if (off < 1e-30) {
+            break;
+        }
+
+        for (uint32_t p = 0; p < N; p++) {
+            for (uint32_t q = p + 1; q < N; q++) {
+                if (A[p][q] == 0) {
+                    continue;
+                }
+
+                // rotate by the angle which zeroes A[p][q]
+                double theta = (A[q][q] - A[p][p]) / (2 * A[p][q]);
+                double t = ((theta >= 0) ? 1. : -1.) /
+                    (fabs(theta) + sqrt(theta * theta + 1));
+                double c = 1 / sqrt(t * t + 1);
+                double s = t * c;
+
+                for (uint32_t k = 0; k < N; k++) {
+                    double akp = A[k][p];
+                    double akq = A[k][q];
+                    A[k][p] = c * akp - s * akq;
+                    A[k][q] = s * akp + c * akq;
+                }
+                for (uint32_t k = 0; k < N; k++) {
+                    double apk = A[p][k];
+                    double aqk = A[q][k];
+                    A[p][k] = c * apk - s * aqk;
+                    A[q][k] = s * apk + c * aqk;
+                }
+                for (uint32_t k = 0; k < N; k++) {
+                    double bkp = B[k][p];
+                    double bkq = B[k][q];
+                    B[k][p] = c * bkp - s * bkq;
+                    B[k][q] = s * bkp + c * bkq;
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < N; i++) {
+        // rounding can make tiny eigenvalues slightly negative
+        D[i] = sqrt(fmax(A[i][i], 1e-20));
+    }
+}
+
+
+static void _cma_init(struct cma *cma, uint32_t lambda, const float *start) {
+    double n = N;
+
+    memset(cma, 0, sizeof(struct cma));
+
+    cma->lambda = (lambda != 0) ? lambda : 4 + (uint32_t) (3 * log(n));
+    cma->mu = cma->lambda / 2;
+
+    cma->w = (double *) malloc(cma->mu * sizeof(double));
+    cma->x = malloc(cma->lambda * sizeof(*cma->x));
+    cma->y = malloc(cma->lambda * sizeof(*cma->y));
+    TETRIS_ASSERT(cma->w != NULL && cma->x != NULL && cma->y != NULL);
+
+    double w_sum = 0;
+    double w_sq_sum = 0;
+    for (uint32_t i = 0; i < cma->mu; i++) {
+        cma->w[i] = log(cma->mu + .5) - log(i + 1);
+        w_sum += cma->w[i];
+    }
+    for (uint32_t i = 0; i < cma->mu; i++) {
+        cma->w[i] /= w_sum;
+        w_sq_sum += cma->w[i] * cma->w[i];
+    }
+    cma->mu_eff = 1 / w_sq_sum;
+
+    double mu_eff = cma->mu_eff;
+    cma->c_sigma = (mu_eff + 2) / (n + mu_eff + 5);
+    cma->d_sigma = 1 + 2 * fmax(0, sqrt((mu_eff - 1) / (n + 1)) - 1) +
+        cma->c_sigma;
+    cma->c_c = (4 + mu_eff / n) / (n + 4 + 2 * mu_eff / n);
+    cma->c_1 = 2 / ((n + 1.3) * (n + 1.3) + mu_eff);
+    cma->c_mu = fmin(1 - cma->c_1, 2 * (mu_eff - 2 + 1 / mu_eff) /
+            ((n + 2) * (n + 2) + mu_eff));
+    cma->chi_n = sqrt(n) * (1 - 1 / (4 * n) + 1 / (21 * n * n));
+
+    for (uint32_t i = 0; i < N; i++) {
+        cma->mean[i] = start[i];
+        cma->C[i][i] = 1;
+        cma->B[i][i] = 1;
+        cma->D[i] = 1;
+    }
+    double len = _norm(cma->mean);
+    for (uint32_t i = 0; i < N; i++) {
+        cma->mean[i] /= len;
+    }
+    cma->sigma = INITIAL_SIGMA;
+}
+
+
+static void _cma_destroy(struct cma *cma) {
+    free(cma->w);
+    free(cma->x);
+    free(cma->y);
+}
+
+
+/*
+ * draws the next generation's samples, x = m + sigma * B D z for standard
+ * normal z
+ */
+static void _cma_sample(struct cma *cma) {
+    for (uint32_t k = 0; k < cma->lambda; k++) {
+        double dz[N];
+        for (uint32_t j = 0; j < N; j++) {
+            dz[j] = cma->D[j] * _gen_normal();
+        }
+        for (uint32_t i = 0; i < N; i++) {
+            double y = 0;
+            for (uint32_t j = 0; j < N; j++) {
+                y += cma->B[i][j] * dz[j];
+            }
+            cma->y[k][i] = y;
+            cma->x[k][i] = cma->mean[i] + cma->sigma * y;
+        }
+    }
+}
+
+
+/*
+ * moves the distribution towards the best samples, where order lists the
+ * samples from best to worst
+ */
+static void _cma_update(struct cma *cma, const uint32_t *order) {
+    double n = N;
+    double y_w[N] = { 0 };
+
+    for (uint32_t k = 0; k < cma->mu; k++) {
+        for (uint32_t i = 0; i < N; i++) {
+            y_w[i] += cma->w[k] * cma->y[order[k]][i];
+        }
+    }
+    for (uint32_t i = 0; i < N; i++) {
+        cma->mean[i] += cma->sigma * y_w[i];
+    }
+
+    // C^(-1/2) y_w = B D^-1 B^T y_w
+    double t[N];
+    double c_inv_sqrt_y[N];
+    for (uint32_t j = 0; j < N; j++) {
+        t[j] = 0;
+        for (uint32_t i = 0; i < N; i++) {
+            t[j] += cma->B[i][j] * y_w[i];
+        }
+        t[j] /= cma->D[j];
+    }
+    for (uint32_t i = 0; i < N; i++) {
+        c_inv_sqrt_y[i] = 0;
+        for (uint32_t j = 0; j < N; j++) {
+            c_inv_sqrt_y[i] += cma->B[i][j] * t[j];
+        }
+    }
+
+    double cs = cma->c_sigma;
+    for (uint32_t i = 0; i < N; i++) {
+        cma->p_sigma[i] = (1 - cs) * cma->p_sigma[i] +
+            sqrt(cs * (2 - cs) * cma->mu_eff) * c_inv_sqrt_y[i];
+    }
+    double ps_norm = _norm(cma->p_sigma);
+
+    // stall the update of p_c while p_sigma is large, so the covariance does
+    // not grow too fast when the step size is too small
+    int h_sigma = ps_norm / sqrt(1 - pow(1 - cs, 2 * (cma->gen + 1))) <
+        (1.4 + 2 / (n + 1)) * cma->chi_n;
+
+    double cc = cma->c_c;
+    for (uint32_t i = 0; i < N; i++) {
+        cma->p_c[i] = (1 - cc) * cma->p_c[i] +
+            h_sigma * sqrt(cc * (2 - cc) * cma->mu_eff) * y_w[i];
+    }
+
+    double c1 = cma->c_1;
+    double cmu = cma->c_mu;
+    double delta = (1 - h_sigma) * cc * (2 - cc);
+    for (uint32_t i = 0; i < N; i++) {
+        for (uint32_t j = 0; j <= i; j++) {
+            double rank_mu = 0;
+            for (uint32_t k = 0; k < cma->mu; k++) {
+                const double *y = cma->y[order[k]];
+                rank_mu += cma->w[k] * y[i] * y[j];
+            }
+
+            double c = (1 - c1 - cmu) * cma->C[i][j] +
+                c1 * (cma->p_c[i] * cma->p_c[j] + delta * cma->C[i][j]) +
+                cmu * rank_mu;
+            cma->C[i][j] = c;
+            cma->C[j][i] = c;
+        }
+    }
+
+    cma->sigma *= exp((cs / cma->d_sigma) * (ps_norm / cma->chi_n - 1));
+
+    // scaling the mean and step size together scales every sample by the
+    // same amount, which does not change the normalized weights played with
+    double len = _norm(cma->mean);
+    for (uint32_t i = 0; i < N; i++) {
+        cma->mean[i] /= len;
+    }
+    cma->sigma /= len;
+
+    _eigen(cma->C, cma->B, cma->D);
+    cma->gen++;
+}
+
+
+
+/*
+ * copies x to cnsts, scaled to unit length
+ */
+static void _to_cnsts(const double *x, float *cnsts) {
+    double len = _norm(x);
+    for (uint32_t i = 0; i < N; i++) {
+        cnsts[i] = (float) (x[i] / len);
+    }
+}
+
+
+static void _print_cnsts(const char *name, const float *cnsts) {
+    printf("  %-6s {", name);
+    for (uint32_t i = 0; i < N; i++) {
+        printf(" %.6ff%s", cnsts[i], (i == N - 1) ? " " : ",");
+    }
+    printf("}\n");
+}
+
+
+
+static void _play(void *arg, uint32_t i) {
+    struct tune_run *run = (struct tune_run *) arg;
+    const struct tune_params *params = run->params;
+    struct tune_job *job = &run->jobs[i];
+    struct headless_result res;
+
+    lha_t *a = linear_heuristic_agent_init_cnsts(job->cnsts);
+    a->depth = params->depth;
+    // games are already played in parallel
+    a->n_threads = 1;
+
+    headless_play(job->seed, 0, params->max_ticks,
+            (int (*)(void *, tetris_state *)) &linear_heuristic_go, a, &res);
+
+    job->lines = res.lines;
+    job->ticks = res.ticks;
+
+    linear_heuristic_agent_destroy(a);
+}
+
+
+
+static const double * __sort_fitness;
+
+static int _fitness_cmp(const void *a, const void *b) {
+    double fa = __sort_fitness[*(const uint32_t *) a];
+    double fb = __sort_fitness[*(const uint32_t *) b];
+    return (fa < fb) - (fa > fb);
+}
+
+
+/*
+ * gives the largest value the option opt can take, which is what fits in its
+ * field of tune_params, or in the agent's depth for the depth
+ */
+static uint64_t _opt_max(int opt) {
+    switch (opt) {
+        case 'm':
+        case 's':
+            return UINT64_MAX;
+        case 'd':
+            return INT32_MAX;
+        default:
+            return UINT32_MAX;
+    }
+}
+
+
+static int usage(char *argv[]) {
+    return headless_usage(argv[0], "[-g generations] "
+            "[-n games per weight vector] [-p population] [-t threads] "
+            "[-d depth] [-m max ticks] [-s seed]");
+}
+
+
+int main(int argc, char *argv[]) {
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    struct tune_params params = {
+        .n_generations = DEFAULT_N_GENERATIONS,
+        .n_games = DEFAULT_N_GAMES,
+        .n_threads = (n_cpus > 1) ? (uint32_t) n_cpus : 1,
+        .depth = DEFAULT_DEPTH,
+        .max_ticks = HEADLESS_DEFAULT_MAX_TICKS,
+        .seed = time(NULL),
+        .lambda = 0
+    };
+
+    int opt;
+    uint64_t val;
+    while ((opt = getopt(argc, argv, "g:n:p:t:d:m:s:")) != -1) {
+        if (opt == '?' ||
+                headless_parse_u64(optarg, _opt_max(opt), &val) != 0) {
+            return usage(argv);
+        }
+        switch (opt) {
+            case 'g':
+                params.n_generations = val;
+                break;
+            case 'n':
+                params.n_games = val;
+                break;
+            case 'p':
+                params.lambda = val;
+                break;
+            case 't':
+                params.n_threads = val;
+                break;
+            case 'd':
+                params.depth = val;
+                break;
+            case 'm':
+                params.max_ticks = val;
+                break;
+            case 's':
+                params.seed = val;
+                break;
+        }
+    }
+    if (params.n_games == 0 || params.n_threads == 0 || params.depth == 0 ||
+            (params.lambda != 0 && params.lambda < 2)) {
+        return usage(argv);
+    }
+
+    // the search's own random numbers come from a different sequence than
+    // the games', which are only ever seeded on the worker threads
+    seed_rand(params.seed, 1);
+
+    struct cma cma;
+    lha_t *def = linear_heuristic_agent_init();
+    _cma_init(&cma, params.lambda, def->cnsts);
+    linear_heuristic_agent_destroy(def);
+
+    uint32_t lambda = cma.lambda;
+    uint32_t n_jobs = lambda * params.n_games;
+
+    float (*cnsts)[N] = malloc(lambda * sizeof(*cnsts));
+    struct tune_job *jobs = (struct tune_job *) malloc(n_jobs *
+            sizeof(struct tune_job));
+    double *fitness = (double *) malloc(lambda * sizeof(double));
+    uint32_t *order = (uint32_t *) malloc(lambda * sizeof(uint32_t));
+    TETRIS_ASSERT(cnsts != NULL && jobs != NULL && fitness != NULL &&
+            order != NULL);
+
+    printf("tuning %d weights: population %u, %u games each, depth %u, "
+            "%u threads, seed %llu\n", N, lambda, params.n_games,
+            params.depth, params.n_threads,
+            (unsigned long long) params.seed);
+
+    float best[N];
+    double best_fitness = -1;
+
+    for (uint32_t gen = 0; gen < params.n_generations; gen++) {
+        uint64_t start = tetris_time_ns();
+
+        _cma_sample(&cma);
+
+        // every weight vector plays the same games, so that they are compared
+        // on equal footing
+        for (uint32_t k = 0; k < lambda; k++) {
+            _to_cnsts(cma.x[k], cnsts[k]);
+            for (uint32_t j = 0; j < params.n_games; j++) {
+                struct tune_job *job = &jobs[k * params.n_games + j];
+                job->cnsts = cnsts[k];
+                job->seed = params.seed + ((uint64_t) gen) * params.n_games +
+                    j;
+            }
+        }
+
+        // none of the games are played on this thread, since seeding them
+        // would reset the random number generator the search samples from
+        struct tune_run run = {
+            .params = &params,
+            .jobs = jobs
+        };
+        headless_run_jobs(n_jobs, params.n_threads, &_play, &run);
+
+        uint64_t ticks = 0;
+        for (uint32_t k = 0; k < lambda; k++) {
+            uint64_t lines = 0;
+            for (uint32_t j = 0; j < params.n_games; j++) {
+                lines += jobs[k * params.n_games + j].lines;
+                ticks += jobs[k * params.n_games + j].ticks;
+            }
+            fitness[k] = ((double) lines) / params.n_games;
+            order[k] = k;
+        }
+
+        __sort_fitness = fitness;
+        qsort(order, lambda, sizeof(uint32_t), &_fitness_cmp);
+
+        double mean_fitness = 0;
+        for (uint32_t k = 0; k < lambda; k++) {
+            mean_fitness += fitness[k] / lambda;
+        }
+
+        // the games differ between generations, so this is only a rough
+        // comparison
+        if (fitness[order[0]] > best_fitness) {
+            best_fitness = fitness[order[0]];
+            memcpy(best, cnsts[order[0]], sizeof(best));
+        }
+
+        double secs = (tetris_time_ns() - start) / 1e9;
+        printf("gen %3u: lines best %8.1f mean %8.1f worst %8.1f  sigma %.4f"
+                "  (%.1fs, %.1f games/s, %.0f ticks/s)\n", gen,
+                fitness[order[0]], mean_fitness, fitness[order[lambda - 1]],
+                cma.sigma, secs, n_jobs / secs, ticks / secs);
+        _print_cnsts("best", cnsts[order[0]]);
+        fflush(stdout);
+
+        _cma_update(&cma, order);
+    }
+
+    float mean[N];
+    _to_cnsts(cma.mean, mean);
+
+    printf("done\n");
+    _print_cnsts("mean", mean);
+    if (best_fitness >= 0) {
+        printf("best single generation result (%.1f lines per game):\n",
+                best_fitness);
+        _print_cnsts("best", best);
+    }
+
+    free(cnsts);
+    free(jobs);
+    free(fitness);
+    free(order);
+    _cma_destroy(&cma);
+
+    return 0;
+}